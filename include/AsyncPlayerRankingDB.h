@@ -0,0 +1,137 @@
+#pragma once
+#ifndef _ASYNC_PLAYER_RANKING_DB_H_
+#define _ASYNC_PLAYER_RANKING_DB_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "PlayerRankingDB.h"
+
+
+template <class T>
+class BoundedMPSCQueue;
+class OperationLog;
+
+
+// PlayerRankingDB front-end with writes queued from any threads and applied by one writer thread.
+// Writer drains queue in batches, every batch of consecutive writes becomes a single version.
+// Reads go directly to DB, lock-free. All methods may be called from any threads.
+// Optional durable mode logs every write before it's acknowledged, one sync covers all writes committed
+// since previous one (group commit). On construction DB is recovered from last checkpoint and log tail.
+// Checkpoints may be incremental: players changed since previous checkpoint are saved as delta over it,
+// and the chain of deltas is merged into full snapshot once they grow to half of its size
+class AsyncPlayerRankingDB {
+public:
+   using Version = PlayerRankingDB::Version;
+
+   struct Options {
+      PlayerRankingDB::Options db;    // concurrentReads is always enabled
+      size_t queueCapacity = 4096;    // pending commands, writers block while queue is full
+      size_t maxBatchSize = 256;      // max writes committed as one version
+
+      // existing directory with checkpoint snapshot and operation log, empty - writes aren't durable.
+      // Constructor throws std::runtime_error if directory holds files which can't be recovered
+      std::string durableDirectory;
+      uint64_t    checkpointLogSize = 64 << 20; // log size which triggers checkpoint in durable mode
+      bool        incrementalCheckpoints = true;
+   };
+
+   AsyncPlayerRankingDB(void);
+   explicit AsyncPlayerRankingDB(const Options& options);
+   // applies all commands queued before and stops writer thread
+   ~AsyncPlayerRankingDB();
+
+   AsyncPlayerRankingDB(const AsyncPlayerRankingDB&) = delete;
+   AsyncPlayerRankingDB& operator=(const AsyncPlayerRankingDB&) = delete;
+
+   // futures become ready with id of the version write was committed in, it's unchanged
+   // version if write was a no-op. Writes of one thread are applied in order they were queued.
+   // In durable mode futures are ready once write is synced to log, they hold std::runtime_error
+   // if it failed - writes of failed sync are reverted and cut off the log, later ones are rejected too
+   // until successful Checkpoint
+   std::future<Version> RegisterPlayerResult(std::string playerName, int playerRating);
+   std::future<Version> UnregisterPlayer(std::string playerName);
+   // reverts `step` versions, queued writes are batched only up to it. In durable mode rollback to version
+   // preceding last checkpoint saves new checkpoint, as recovery doesn't restore history before it
+   std::future<Version> Rollback(int step);
+   // ready once every write queued before is committed
+   std::future<Version> Flush(void);
+   // saves snapshot of current version (or delta over previous checkpoint) and starts empty log, so recovery
+   // doesn't replay older writes. Writes wait while snapshot is saved. Same as Flush if DB isn't durable
+   std::future<Version> Checkpoint(void);
+
+   Version GetVersion(void) const { return db.GetVersion(); }
+   int GetPlayerRank(const std::string& playerName) const { return db.GetPlayerRank(playerName); }
+   std::vector<PlayerRankingDB::PlayerInfoRow> GetPlayersInfo(void) const { return db.GetPlayersInfo(); }
+   PlayerRankingDB::Snapshot GetSnapshot(void) const { return db.GetSnapshot(); }
+
+private:
+   enum class CommandType : unsigned char {
+      WRITE,
+      ROLLBACK,
+      FLUSH,
+      CHECKPOINT,
+      STOP,
+   };
+
+   struct Command {
+      CommandType                   type = CommandType::WRITE;
+      PlayerRankingDB::WriteCommand write;
+      int                           step = 0;
+      std::promise<Version>         done;
+   };
+
+   std::future<Version> Push(Command&& command);
+   void WriterLoop();
+   void CommitBatch(std::vector<Command>& batch);
+   bool ApplyRollback(int step);
+   void Complete(std::promise<Version>&& done);
+   void WaitForCommands();
+
+   void Recover();
+   void LoadCheckpoint();
+   bool SaveCheckpoint();
+   void SyncLog();
+   void RevertUnsynced();
+   std::string GetLogPath() const;
+   std::string GetSnapshotPath(uint64_t checkpoint) const;
+   std::string GetDeltaPath(uint64_t checkpoint) const;
+
+   size_t          maxBatchSize;
+   PlayerRankingDB db;
+
+   std::unique_ptr<BoundedMPSCQueue<Command>> queue;
+   // writer announces it's going to sleep, producers wake it up only then
+   std::atomic<bool>       writerSleeping{ false };
+   std::mutex              wakeMutex;
+   std::condition_variable wakeCondition;
+
+   // durable mode state, owned by writer thread
+   std::string                   durableDirectory;
+   uint64_t                      checkpointLogSize;
+   std::unique_ptr<OperationLog> log;
+   bool                          incrementalCheckpoints;
+   uint64_t                      checkpoint = 0; // number of last checkpoint, its snapshot or delta is named by it
+   // last checkpoint with full snapshot, later ones are deltas. Their sizes decide when chain is merged
+   uint64_t                      baseCheckpoint = 0;
+   uint64_t                      baseBytes = 0;
+   uint64_t                      deltaBytes = 0;
+   Version                       checkpointVersion = 0; // version saved by last checkpoint
+   bool                          logFailed = false;
+   // results of logged commands, given out once log is synced
+   std::vector<std::pair<std::promise<Version>, Version>> unsynced;
+   // last version known to be durable, DB returns to it if sync fails
+   std::optional<PlayerRankingDB::Snapshot> synced;
+
+   std::thread writer;
+};
+
+
+#endif // _ASYNC_PLAYER_RANKING_DB_H_
@@ -0,0 +1,66 @@
+#pragma once
+#ifndef _LEADERBOARD_READER_H_
+#define _LEADERBOARD_READER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+// Read-only leaderboard file written by PlayerRankingDB::Snapshot::SaveLeaderboard(path) - the only writer of
+// this format, ExportLeaderboard streams of either ExportFormat can't be opened. File is memory mapped
+// and queried in place - nothing is parsed on Open, and processes serving the same file share its pages
+// in page cache. Reader is immutable once opened, so it may be used from any threads
+class LeaderboardReader {
+public:
+   using Version = uint64_t;
+
+   // name views point into mapped file and stay valid while reader is open
+   struct Row {
+      std::string_view name;
+      int              rating;
+      int              ranking;
+   };
+
+   LeaderboardReader(void) = default;
+   LeaderboardReader(LeaderboardReader&& other) noexcept;
+   LeaderboardReader& operator=(LeaderboardReader&& other) noexcept;
+   ~LeaderboardReader();
+
+   LeaderboardReader(const LeaderboardReader&) = delete;
+   LeaderboardReader& operator=(const LeaderboardReader&) = delete;
+
+   // maps file, returns false if it can't be read or its layout doesn't match. Previous file is unmapped
+   bool Open(const std::string& path);
+   void Close(void);
+   bool IsOpen(void) const { return data != nullptr; }
+
+   Version GetVersion(void) const;
+   size_t GetPlayersCount(void) const;
+
+   // 0 for unknown player. O(1)
+   int GetPlayerRank(std::string_view playerName) const;
+   std::optional<Row> FindPlayer(std::string_view playerName) const;
+
+   // row at zero-based position in ranking order (equal ratings by name), position < GetPlayersCount()
+   Row GetRowAt(size_t position) const;
+   // `count` rows starting from `offset`, O(count)
+   std::vector<Row> GetPlayersPage(size_t offset, size_t count) const;
+   std::vector<Row> GetTopPlayers(size_t count) const { return GetPlayersPage(0, count); }
+
+private:
+   const void* data = nullptr;
+   size_t      size = 0;
+
+   // sections of mapped file
+   const void*     header = nullptr;
+   const void*     records = nullptr;
+   const uint32_t* index = nullptr;
+   const char*     names = nullptr;
+};
+
+
+#endif // _LEADERBOARD_READER_H_
@@ -2,18 +2,108 @@
 #ifndef _PLAYER_RANKING_DB_H_
 #define _PLAYER_RANKING_DB_H_
 
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 
 class PlayerRankingDB {
 public:
+   enum class ArenaPages : unsigned char {
+      REGULAR = 0,          // default OS pages
+      HUGE_TRANSPARENT = 1, // back arenas with 2MB pages where OS allows (transparent huge pages)
+      HUGE_EXPLICIT = 2,    // explicit huge pages (MAP_HUGETLB / MEM_LARGE_PAGES), falls back to transparent ones
+      FILE_BACKED = 3,      // scratch files in arenaDirectory, so cold arena pages go there instead of swap
+   };
+
+   struct Options {
+      // address space reserved by each node/entry arena, multiple of 1MB. Node arenas are capped at 16GB,
+      // the reach of their 32-bit links
+      size_t     arenaReserveSize = 100 << 20;
+      ArenaPages arenaPages = ArenaPages::REGULAR;
+      // directory of scratch files backing arenas with FILE_BACKED pages, those are deleted along with arenas.
+      // They only move cold pages out of swap - arenas can't be re-mapped on restart, as entries hold
+      // heap and cross-arena pointers. Restart goes through SaveSnapshot/LoadSnapshot
+      std::string arenaDirectory;
+      // max number of steps Rollback can revert, 0 - unlimited. Versions older than that are dropped and
+      // arenas are compacted once their usage doubles since previous compaction
+      size_t     maxHistoryDepth = 0;
+      // GetPlayerRank, GetPlayersInfo, GetVersion and GetSnapshot may be called from any threads concurrently
+      // with a single writer thread, without locks. Other methods must be called by writer thread only
+      bool       concurrentReads = false;
+   };
+
+   // id of database version, every write creates version with id greater than all previous ones
+   using Version = uint64_t;
+
    PlayerRankingDB(void);
+   explicit PlayerRankingDB(const Options& options);
+   PlayerRankingDB(PlayerRankingDB&&) noexcept;
+   PlayerRankingDB& operator=(PlayerRankingDB&&) noexcept;
    ~PlayerRankingDB();
 
-   void RegisterPlayerResult(std::string playerName, int playerRating);
-   void UnregisterPlayer(const std::string& playerName);
+   // independent DB starting at current version. All existing nodes are shared with this DB
+   // (never reused by it afterwards), new ones are allocated in fork's own arenas
+   PlayerRankingDB Fork(void) const;
+
+   // writes return id of resulting version, it's unchanged when write is a no-op
+   Version RegisterPlayerResult(std::string playerName, int playerRating);
+   Version UnregisterPlayer(const std::string& playerName);
+
+   // one write of a batch, no rating means unregistering player
+   struct WriteCommand {
+      std::string        playerName;
+      std::optional<int> playerRating;
+   };
+   // applies commands in order as a single version, so one Rollback step reverts the whole batch
+   Version ApplyBatch(std::vector<WriteCommand> commands);
+
+   // replaces all players with given ones as a single version, the last of equal names wins.
+   // Both trees are built directly from sorted input on `threadsCount` threads (0 - one per hardware thread).
+   // Returns id of loaded version, or nothing - keeping DB unchanged - if arenas can't fit the trees
+   std::optional<Version> BulkLoad(std::vector<std::pair<std::string, int>> players, size_t threadsCount = 0);
+
+   // saves current version into file, see Snapshot::Save
+   bool SaveSnapshot(const std::string& path) const;
+   // replaces all players with ones saved by SaveSnapshot as a single version, built in time linear to file size
+   // on `threadsCount` threads (0 - one per hardware thread). Version takes saved id unless this DB already gave
+   // greater ones. Returns false, keeping DB unchanged, if file can't be read, is corrupted or doesn't fit into arenas
+   bool LoadSnapshot(const std::string& path, size_t threadsCount = 0);
+   // replaces all players with ones from CSV (',' separator) or TSV ('\t') file of `name,rating` lines as a single
+   // version, the last of equal names wins. Names may be quoted, header line is skipped. File is parsed in chunks
+   // and duplicates are dropped on the way, so memory depends on distinct players, not on file size. Trees are
+   // built as by BulkLoad. Returns false, keeping DB unchanged, if file can't be read, has malformed lines or
+   // doesn't fit into arenas
+   bool ImportPlayers(const std::string& path, char separator = ',', size_t threadsCount = 0);
+   // saves players changed since retained `fromVersion` (see ChangedPlayers), so file size is proportional
+   // to churn rather than to players count. Returns false if version was dropped or on I/O error
+   bool SaveChanges(const std::string& path, Version fromVersion) const;
+   // applies changes saved by SaveChanges as a single version. Version takes saved id unless this DB already gave
+   // greater ones. Returns false, keeping DB unchanged, if file can't be read or is corrupted
+   bool ApplyChanges(const std::string& path);
+
+   // reverts `step` versions - no-op writes made none, so they aren't counted as steps
    void Rollback(int step);
+   // reapplies up to `step` rolled back versions, those are kept until next write
+   void Redo(int step);
+
+   Version GetVersion(void) const;
+   // greatest id given to a version so far, greater than current one after Rollback
+   Version GetLastVersion(void) const;
+   // ids up to `version` aren't given to new versions, so DB restored to older state doesn't reuse ids given since
+   void ReserveVersions(Version version);
+   // id of version Rollback(step) moves to
+   Version GetRollbackVersion(int step) const;
+   // moves to any retained version, rolled back ones included. Returns false if version was dropped
+   bool RollbackTo(Version version);
+   // names current version, tag is moved if already exists
+   void Tag(std::string name);
+   bool RollbackToTag(const std::string& name);
 
    int GetPlayerRank(const std::string& playerName) const;
 
@@ -26,9 +116,101 @@ public:
    };
    std::vector<PlayerInfoRow> GetPlayersInfo(void) const;
 
+   enum class ExportFormat : unsigned char {
+      CSV = 0,    // "name,rating,ranking" header line, then line per player. Names are quoted if needed
+      BINARY = 1, // uint64 players count, then per player: uint32 name size, name, int32 rating, int32 ranking. Little-endian
+   };
+   // writes current version, see Snapshot::ExportLeaderboard
+   bool ExportLeaderboard(std::ostream& out, ExportFormat format = ExportFormat::CSV) const;
+
+   // queries against any retained version (see HasVersion) without moving current one,
+   // not retained version is reported as empty database
+   bool HasVersion(Version version) const;
+   int GetPlayerRankAt(Version version, const std::string& playerName) const;
+   std::vector<PlayerInfoRow> GetPlayersInfoAt(Version version) const;
+
+   // rating change of one player, no rating means player wasn't registered
+   struct PlayerRatingChange {
+      std::string        name;
+      std::optional<int> fromRating;
+      std::optional<int> toRating;
+   };
+   // players with changed ratings between two retained versions (in any order), sorted by name.
+   // Rankings of other players shift accordingly, but aren't reported
+   std::vector<PlayerRatingChange> ChangedPlayers(Version fromVersion, Version toVersion) const;
+
+   class Snapshot;
+   // immutable handle to current version, see Snapshot
+   Snapshot GetSnapshot(void) const;
+
+   struct ArenaStats {
+      size_t reservedBytes = 0;  // address space reserved by arena
+      size_t committedBytes = 0; // physical memory committed by arena
+      size_t usedBytes = 0;      // memory taken by allocated objects
+      size_t count = 0;          // number of allocated objects
+   };
+
+   struct MemoryStats {
+      ArenaStats ratingsNodes;
+      ArenaStats ratingsEntries;
+      ArenaStats rankingsNodes;
+      ArenaStats rankingsEntries;
+
+      size_t namesHeapBytes = 0; // heap memory of player names not fitting into std::string inline buffer, by their lengths
+      size_t liveBytes = 0;      // nodes, entries and names reachable from current version
+      size_t historyBytes = 0;   // arena and names memory used by retained versions only
+
+      size_t              historyDepth = 0; // number of versions available for Rollback
+      size_t              redoDepth = 0;    // number of rolled back versions available for Redo
+      std::vector<size_t> versionBytes;     // arena bytes allocated by each retained version (including rolled back ones), oldest first
+   };
+   MemoryStats GetMemoryStats(void) const;
+
 private:
    struct Impl;
+   struct PublishedVersion;
    std::unique_ptr<Impl> impl;
+
+   explicit PlayerRankingDB(std::unique_ptr<Impl> impl);
+};
+
+
+// Read-only view of one DB version, cheap to copy. Its nodes stay alive and unchanged while any copy
+// is held - writes, Rollback, history compaction and even DB destruction don't affect it.
+// Snapshot may be read from any threads, no matter if DB was created with concurrentReads
+class PlayerRankingDB::Snapshot {
+public:
+   Version GetVersion(void) const;
+   size_t GetPlayersCount(void) const;
+
+   int GetPlayerRank(const std::string& playerName) const;
+   std::vector<PlayerInfoRow> GetPlayersInfo(void) const;
+   // same as GetPlayersInfo, but rows are filled by `threadsCount` threads (0 - one per hardware thread)
+   std::vector<PlayerInfoRow> ExportPlayersInfo(size_t threadsCount = 0) const;
+   std::optional<int> GetPlayerRating(const std::string& playerName) const;
+   // number of players with greater rating, rating doesn't have to be taken by anyone. O(log N)
+   size_t CountPlayersAbove(int rating) const;
+
+   // players ordered by ranking (equal ones by name), `count` of them starting from zero-based `offset`.
+   // O(log N + count) - first player is found by position and the rest follow it in ranking order
+   std::vector<PlayerInfoRow> GetPlayersPage(size_t offset, size_t count) const;
+   std::vector<PlayerInfoRow> GetTopPlayers(size_t count) const { return GetPlayersPage(0, count); }
+
+   // writes players into file in compact binary format: names sorted and prefix-compressed, ratings as varints,
+   // no tree nodes. File at `path` is replaced only once new one is complete and durable. Returns false on I/O error
+   bool Save(const std::string& path) const;
+   // writes immutable leaderboard file to be served by LeaderboardReader: fixed-width records in ranking order,
+   // name hash index and names. File at `path` is replaced only once new one is complete and durable
+   bool SaveLeaderboard(const std::string& path) const;
+   // streams players in ranking order (equal ones by name) through reusable buffer, no rows are collected.
+   // Returns false once stream fails
+   bool ExportLeaderboard(std::ostream& out, ExportFormat format = ExportFormat::CSV) const;
+
+private:
+   friend class PlayerRankingDB;
+   explicit Snapshot(std::shared_ptr<const PublishedVersion> version);
+
+   std::shared_ptr<const PublishedVersion> version;
 };
 
 
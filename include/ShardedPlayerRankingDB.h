@@ -0,0 +1,85 @@
+#pragma once
+#ifndef _SHARDED_PLAYER_RANKING_DB_H_
+#define _SHARDED_PLAYER_RANKING_DB_H_
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "PlayerRankingDB.h"
+
+
+// Players partitioned by name hash across independent PlayerRankingDB shards, each with its own arenas
+// and writer lock, so writes of players from different shards run in parallel. Global ranking is
+// one plus sum of per-shard counts of players with greater rating.
+// All methods may be called from any threads.
+class ShardedPlayerRankingDB {
+public:
+   using PlayerInfoRow = PlayerRankingDB::PlayerInfoRow;
+   // versions of all shards, in shard order
+   using VersionVector = std::vector<PlayerRankingDB::Version>;
+
+   // shards are always created with concurrentReads
+   explicit ShardedPlayerRankingDB(size_t shardCount, PlayerRankingDB::Options options = PlayerRankingDB::Options());
+   ~ShardedPlayerRankingDB();
+
+   size_t GetShardCount(void) const { return shards.size(); }
+
+   void RegisterPlayerResult(std::string playerName, int playerRating);
+   void UnregisterPlayer(const std::string& playerName);
+
+   // version of every shard taken at once - no write is seen without writes completed before it
+   VersionVector GetVersion(void) const;
+   // moves every shard to its version, nothing is changed if any of them isn't retained
+   bool RollbackTo(const VersionVector& version);
+
+   // reads all shards at one version vector, see GetSnapshot. Shard locks are held only to take their snapshots
+   int GetPlayerRank(const std::string& playerName) const;
+
+   class Snapshot;
+   // consistent view of all shards, see GetVersion
+   Snapshot GetSnapshot(void) const;
+
+private:
+   struct Shard {
+      std::mutex      writeMutex;
+      PlayerRankingDB db;
+
+      explicit Shard(const PlayerRankingDB::Options& options) : db(options) {}
+   };
+
+   Shard& ShardOf(const std::string& playerName) const;
+   std::vector<std::unique_lock<std::mutex>> LockAll(void) const;
+
+   std::vector<std::unique_ptr<Shard>> shards;
+};
+
+
+// Read-only view of all shards, keeps them readable while held as PlayerRankingDB::Snapshot does
+class ShardedPlayerRankingDB::Snapshot {
+public:
+   const VersionVector& GetVersion(void) const { return version; }
+   size_t GetPlayersCount(void) const;
+
+   int GetPlayerRank(const std::string& playerName) const;
+   // all players ordered by name
+   std::vector<PlayerInfoRow> GetPlayersInfo(void) const;
+
+   // players ordered by ranking (equal ones by name), `count` of them starting from zero-based `offset`.
+   // Every shard contributes its first offset + count players, so deep pages are expensive
+   std::vector<PlayerInfoRow> GetPlayersPage(size_t offset, size_t count) const;
+   std::vector<PlayerInfoRow> GetTopPlayers(size_t count) const { return GetPlayersPage(0, count); }
+
+private:
+   friend class ShardedPlayerRankingDB;
+   Snapshot() = default;
+
+   int GetRatingRank(int rating) const;
+
+   std::vector<PlayerRankingDB::Snapshot> shards;
+   VersionVector                          version;
+};
+
+
+#endif // _SHARDED_PLAYER_RANKING_DB_H_
@@ -0,0 +1,422 @@
+#include "AsyncPlayerRankingDB.h"
+
+#include <cassert>
+#include <stdexcept>
+
+#include "BoundedMPSCQueue.h"
+#include "File.h"
+#include "OperationLog.h"
+
+
+// deltas are merged into full snapshot once they take half of its size, so recovery reads at most
+// 1.5 times as much as from single snapshot
+static const uint64_t deltaBytesShare = 2;
+static const uint64_t maxDeltasCount = 256;
+
+
+static PlayerRankingDB::Options WithConcurrentReads(PlayerRankingDB::Options options)
+{
+   options.concurrentReads = true;
+   return options;
+}
+
+
+AsyncPlayerRankingDB::AsyncPlayerRankingDB (void)
+   : AsyncPlayerRankingDB(Options())
+{}
+
+
+AsyncPlayerRankingDB::AsyncPlayerRankingDB (const Options& options)
+   : maxBatchSize(options.maxBatchSize)
+   , db(WithConcurrentReads(options.db))
+   , queue(std::make_unique<BoundedMPSCQueue<Command>>(options.queueCapacity))
+   , durableDirectory(options.durableDirectory)
+   , checkpointLogSize(options.checkpointLogSize)
+   , incrementalCheckpoints(options.incrementalCheckpoints)
+{
+   assert(maxBatchSize > 0);
+   if (!durableDirectory.empty()) {
+      Recover();
+   }
+   writer = std::thread(&AsyncPlayerRankingDB::WriterLoop, this);
+}
+
+
+AsyncPlayerRankingDB::~AsyncPlayerRankingDB ()
+{
+   Command stop;
+   stop.type = CommandType::STOP;
+   Push(std::move(stop));
+   writer.join();
+}
+
+
+auto AsyncPlayerRankingDB::RegisterPlayerResult(std::string playerName, int playerRating) -> std::future<Version>
+{
+   Command command;
+   command.write = PlayerRankingDB::WriteCommand{ std::move(playerName), playerRating };
+   return Push(std::move(command));
+}
+
+
+auto AsyncPlayerRankingDB::UnregisterPlayer(std::string playerName) -> std::future<Version>
+{
+   Command command;
+   command.write = PlayerRankingDB::WriteCommand{ std::move(playerName), std::nullopt };
+   return Push(std::move(command));
+}
+
+
+auto AsyncPlayerRankingDB::Rollback(int step) -> std::future<Version>
+{
+   Command command;
+   command.type = CommandType::ROLLBACK;
+   command.step = step;
+   return Push(std::move(command));
+}
+
+
+auto AsyncPlayerRankingDB::Flush (void) -> std::future<Version>
+{
+   Command command;
+   command.type = CommandType::FLUSH;
+   return Push(std::move(command));
+}
+
+
+auto AsyncPlayerRankingDB::Checkpoint (void) -> std::future<Version>
+{
+   Command command;
+   command.type = CommandType::CHECKPOINT;
+   return Push(std::move(command));
+}
+
+
+auto AsyncPlayerRankingDB::Push(Command&& command) -> std::future<Version>
+{
+   auto future = command.done.get_future();
+   while (!queue->TryPush(std::move(command))) {
+      // queue is full - writer is behind, give it time
+      std::this_thread::yield();
+   }
+
+   // pairs with fence in WaitForCommands: either writer sees pushed command or we see it sleeping
+   std::atomic_thread_fence(std::memory_order_seq_cst);
+   if (writerSleeping.load(std::memory_order_relaxed)) {
+      std::lock_guard<std::mutex> lock(wakeMutex);
+      wakeCondition.notify_one();
+   }
+   return future;
+}
+
+
+void AsyncPlayerRankingDB::WaitForCommands()
+{
+   std::unique_lock<std::mutex> lock(wakeMutex);
+   writerSleeping.store(true, std::memory_order_relaxed);
+   std::atomic_thread_fence(std::memory_order_seq_cst);
+   wakeCondition.wait(lock, [this] { return !queue->IsEmpty(); });
+   writerSleeping.store(false, std::memory_order_relaxed);
+}
+
+
+void AsyncPlayerRankingDB::WriterLoop()
+{
+   std::vector<Command> batch;
+   batch.reserve(maxBatchSize);
+
+   for (;;) {
+      Command command;
+      while (batch.size() < maxBatchSize && queue->TryPop(command)) {
+         if (command.type == CommandType::WRITE) {
+            batch.push_back(std::move(command));
+            continue;
+         }
+
+         // other commands are ordered after all writes queued before them
+         CommitBatch(batch);
+         bool succeeded = true;
+         switch (command.type) {
+         case CommandType::ROLLBACK:
+            succeeded = ApplyRollback(command.step);
+            break;
+         case CommandType::CHECKPOINT:
+            SyncLog();
+            succeeded = !log || SaveCheckpoint();
+            break;
+         case CommandType::STOP:
+            Complete(std::move(command.done));
+            SyncLog();
+            return;
+         default:
+            break;
+         }
+         if (succeeded) {
+            Complete(std::move(command.done));
+         } else {
+            command.done.set_exception(std::make_exception_ptr(std::runtime_error("operation log failed")));
+         }
+      }
+
+      bool idle = batch.empty();
+      CommitBatch(batch);
+      // group commit - writes committed while previous sync was running share the next one
+      SyncLog();
+      if (log && !logFailed && log->GetSize() >= checkpointLogSize) {
+         SaveCheckpoint();
+      }
+      if (idle) {
+         WaitForCommands();
+      }
+   }
+}
+
+
+void AsyncPlayerRankingDB::CommitBatch(std::vector<Command>& batch)
+{
+   if (batch.empty()) {
+      return;
+   }
+   if (log && logFailed) {
+      // nothing is applied which can't be logged
+      for (auto& command : batch) {
+         command.done.set_exception(std::make_exception_ptr(std::runtime_error("operation log failed")));
+      }
+      batch.clear();
+      return;
+   }
+
+   OperationLog::Record record;
+   record.commands.reserve(batch.size());
+   for (auto& command : batch) {
+      record.commands.push_back(std::move(command.write));
+   }
+
+   try {
+      if (log) {
+         log->Append(record);
+      }
+      db.ApplyBatch(std::move(record.commands));
+      for (auto& command : batch) {
+         Complete(std::move(command.done));
+      }
+   } catch (...) {
+      for (auto& command : batch) {
+         command.done.set_exception(std::current_exception());
+      }
+   }
+   batch.clear();
+}
+
+
+bool AsyncPlayerRankingDB::ApplyRollback(int step)
+{
+   if (!log) {
+      db.Rollback(step);
+      return true;
+   }
+   if (logFailed) {
+      return false;
+   }
+
+   const Version version = db.GetRollbackVersion(step);
+   if (version >= checkpointVersion) {
+      // version was written since checkpoint, so recovery replays it too and can move back to it by id
+      OperationLog::Record record;
+      record.type = OperationLog::RecordType::ROLLBACK;
+      record.version = version;
+      log->Append(record);
+      db.RollbackTo(version);
+      return true;
+   }
+
+   // history preceding checkpoint isn't recovered, so rollback into it is made durable by checkpoint.
+   // Writes logged before are synced first, as checkpoint starts empty log
+   SyncLog();
+   if (logFailed) {
+      return false;
+   }
+   db.RollbackTo(version);
+   if (!SaveCheckpoint()) {
+      RevertUnsynced();
+      return false;
+   }
+   return true;
+}
+
+
+void AsyncPlayerRankingDB::Complete(std::promise<Version>&& done)
+{
+   if (log) {
+      unsynced.emplace_back(std::move(done), db.GetVersion());
+   } else {
+      done.set_value(db.GetVersion());
+   }
+}
+
+
+void AsyncPlayerRankingDB::SyncLog()
+{
+   if (unsynced.empty()) {
+      return;
+   }
+   const bool failed = logFailed || !log->Sync();
+   if (failed) {
+      logFailed = true;
+      RevertUnsynced();
+      // log keeps failed records if they couldn't be cut off, checkpoint replaces it before they are replayed
+      if (!log->IsOpen()) {
+         SaveCheckpoint();
+      }
+   } else {
+      synced = db.GetSnapshot();
+   }
+   for (auto& [done, version] : unsynced) {
+      if (failed) {
+         done.set_exception(std::make_exception_ptr(std::runtime_error("operation log failed")));
+      } else {
+         done.set_value(version);
+      }
+   }
+   unsynced.clear();
+}
+
+
+void AsyncPlayerRankingDB::RevertUnsynced()
+{
+   // readers may have seen writes which aren't durable, but nothing else is built on them -
+   // they are neither acknowledged nor checkpointed
+   if (db.RollbackTo(synced->GetVersion())) {
+      return;
+   }
+   // durable version was dropped from history or discarded by later write, its players are loaded back
+   std::vector<std::pair<std::string, int>> players;
+   for (auto& row : synced->GetPlayersInfo()) {
+      players.emplace_back(std::move(row.name), row.rating);
+   }
+   db.BulkLoad(std::move(players));
+}
+
+
+std::string AsyncPlayerRankingDB::GetLogPath() const
+{
+   return durableDirectory + "/operations.log";
+}
+
+
+std::string AsyncPlayerRankingDB::GetSnapshotPath(uint64_t checkpoint) const
+{
+   return durableDirectory + "/snapshot." + std::to_string(checkpoint);
+}
+
+
+std::string AsyncPlayerRankingDB::GetDeltaPath(uint64_t checkpoint) const
+{
+   return durableDirectory + "/delta." + std::to_string(checkpoint);
+}
+
+
+bool AsyncPlayerRankingDB::SaveCheckpoint()
+{
+   // log names checkpoint it follows and is replaced only after new snapshot is durable,
+   // so crash at any point leaves either previous checkpoint with its log or new one with empty log
+   const uint64_t next = checkpoint + 1;
+   // delta holds players changed since previous checkpoint, found by comparing its tree with current one.
+   // Its version keeps id on loading only if it's greater than ids of the chain, so not after rollback into it
+   const bool incremental = incrementalCheckpoints && next - baseCheckpoint <= maxDeltasCount
+      && deltaBytes * deltaBytesShare < baseBytes && db.HasVersion(checkpointVersion) && db.GetVersion() > checkpointVersion;
+   const std::string path = incremental ? GetDeltaPath(next) : GetSnapshotPath(next);
+   // file left by failed attempt of the same checkpoint would be mistaken for part of chain
+   File::Remove(incremental ? GetSnapshotPath(next) : GetDeltaPath(next));
+   if (!(incremental ? db.SaveChanges(path, checkpointVersion) : db.SaveSnapshot(path))) {
+      return false;
+   }
+   if (!log->Create(GetLogPath(), next, db.GetLastVersion())) {
+      logFailed = true;
+      return false;
+   }
+
+   uint64_t bytes = 0;
+   File::GetSize(path, bytes);
+   if (incremental) {
+      deltaBytes += bytes;
+   } else {
+      // merged snapshot replaces the whole chain
+      if (baseCheckpoint != 0) {
+         File::Remove(GetSnapshotPath(baseCheckpoint));
+      }
+      for (uint64_t delta = baseCheckpoint + 1; delta <= checkpoint; ++delta) {
+         File::Remove(GetDeltaPath(delta));
+      }
+      baseCheckpoint = next;
+      baseBytes = bytes;
+      deltaBytes = 0;
+   }
+   checkpoint = next;
+   checkpointVersion = db.GetVersion();
+   // writes of failed sync were reverted, so snapshot holds only acknowledged ones
+   synced = db.GetSnapshot();
+   logFailed = false;
+   return true;
+}
+
+
+void AsyncPlayerRankingDB::LoadCheckpoint()
+{
+   // chain starts from the latest full snapshot, or from empty DB if there is none
+   baseCheckpoint = checkpoint;
+   while (baseCheckpoint != 0 && !File::Exists(GetSnapshotPath(baseCheckpoint))) {
+      if (!File::Exists(GetDeltaPath(baseCheckpoint))) {
+         throw std::runtime_error("checkpoint " + std::to_string(baseCheckpoint) + " is missing");
+      }
+      --baseCheckpoint;
+   }
+   if (baseCheckpoint != 0) {
+      if (!db.LoadSnapshot(GetSnapshotPath(baseCheckpoint))) {
+         throw std::runtime_error("snapshot of checkpoint " + std::to_string(baseCheckpoint) + " can't be loaded");
+      }
+      File::GetSize(GetSnapshotPath(baseCheckpoint), baseBytes);
+   }
+   for (uint64_t delta = baseCheckpoint + 1; delta <= checkpoint; ++delta) {
+      if (!db.ApplyChanges(GetDeltaPath(delta))) {
+         throw std::runtime_error("delta of checkpoint " + std::to_string(delta) + " can't be loaded");
+      }
+      uint64_t bytes = 0;
+      File::GetSize(GetDeltaPath(delta), bytes);
+      deltaBytes += bytes;
+   }
+}
+
+
+void AsyncPlayerRankingDB::Recover()
+{
+   log = std::make_unique<OperationLog>();
+   std::vector<OperationLog::Record> records;
+   bool complete = true;
+   Version lastVersion = 0;
+   if (OperationLog::Read(GetLogPath(), checkpoint, lastVersion, records, complete)) {
+      LoadCheckpoint();
+      // ids given before checkpoint aren't reused, so replayed writes get ids they were acknowledged with
+      db.ReserveVersions(lastVersion);
+   } else if (File::Exists(GetLogPath())) {
+      throw std::runtime_error("operation log is corrupted");
+   }
+   checkpointVersion = db.GetVersion();
+
+   for (auto& record : records) {
+      if (record.type == OperationLog::RecordType::BATCH) {
+         db.ApplyBatch(std::move(record.commands));
+      } else if (!db.RollbackTo(record.version)) {
+         // only versions written since checkpoint are rolled back to in log, so they are replayed before
+         throw std::runtime_error("version " + std::to_string(record.version) + " rolled back to isn't recovered");
+      }
+   }
+
+   // replayed writes are checkpointed, which also drops torn tail of log
+   bool started = records.empty() && complete ? log->Create(GetLogPath(), checkpoint, db.GetLastVersion()) : SaveCheckpoint();
+   if (!started) {
+      throw std::runtime_error("operation log can't be started");
+   }
+   synced = db.GetSnapshot();
+}
+
@@ -0,0 +1,47 @@
+#pragma once
+#ifndef _BOUNDED_MPSC_QUEUE_H_
+#define _BOUNDED_MPSC_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+
+// Lock-free bounded queue for many producers and a single consumer. Every cell carries sequence
+// number telling whether it's free for producer at given position or filled for consumer,
+// so producers only contend on claiming position and never wait for each other.
+template <class T>
+class BoundedMPSCQueue {
+public:
+   explicit BoundedMPSCQueue(size_t capacity); // rounded up to power of two
+
+   BoundedMPSCQueue(const BoundedMPSCQueue&) = delete;
+   BoundedMPSCQueue& operator=(const BoundedMPSCQueue&) = delete;
+
+   // any thread: returns false if queue is full, value is left untouched then
+   bool TryPush(T&& value);
+   // consumer only
+   bool TryPop(T& value);
+   bool IsEmpty() const;
+
+   size_t GetCapacity() const { return mask + 1; }
+
+private:
+   struct Cell {
+      std::atomic<size_t> sequence;
+      T                   value;
+   };
+
+   std::unique_ptr<Cell[]> cells;
+   size_t                  mask;
+
+   // producers and consumer positions on separate cache lines
+   alignas(64) std::atomic<size_t> pushPosition{ 0 };
+   alignas(64) size_t              popPosition = 0;
+};
+
+
+#include "BoundedMPSCQueue.hpp"
+
+#endif // _BOUNDED_MPSC_QUEUE_H_
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "BoundedMPSCQueue.h"
+#include <utility>
+
+
+
+template <class T>
+BoundedMPSCQueue<T>::BoundedMPSCQueue(size_t capacity)
+{
+   size_t size = 1;
+   while (size < capacity) {
+      size *= 2;
+   }
+   mask = size - 1;
+
+   cells.reset(new Cell[size]);
+   for (size_t i = 0; i < size; ++i) {
+      // cell is free for producer at position i
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+   }
+}
+
+
+template <class T>
+bool BoundedMPSCQueue<T>::TryPush(T&& value)
+{
+   size_t position = pushPosition.load(std::memory_order_relaxed);
+   Cell* cell;
+   for (;;) {
+      cell = &cells[position & mask];
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)sequence - (intptr_t)position;
+      if (diff == 0) {
+         if (pushPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+            break;
+         }
+      } else if (diff < 0) {
+         // cell still holds value pushed one lap ago
+         return false;
+      } else {
+         // other producer took this position
+         position = pushPosition.load(std::memory_order_relaxed);
+      }
+   }
+
+   cell->value = std::move(value);
+   cell->sequence.store(position + 1, std::memory_order_release);
+   return true;
+}
+
+
+template <class T>
+bool BoundedMPSCQueue<T>::TryPop(T& value)
+{
+   Cell& cell = cells[popPosition & mask];
+   if (cell.sequence.load(std::memory_order_acquire) != popPosition + 1) {
+      return false;
+   }
+
+   value = std::move(cell.value);
+   // free for producer one lap ahead
+   cell.sequence.store(popPosition + mask + 1, std::memory_order_release);
+   ++popPosition;
+   return true;
+}
+
+
+template <class T>
+bool BoundedMPSCQueue<T>::IsEmpty() const
+{
+   return cells[popPosition & mask].sequence.load(std::memory_order_acquire) != popPosition + 1;
+}
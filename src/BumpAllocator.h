@@ -0,0 +1,55 @@
+#pragma once
+#ifndef _BUMP_ALLOCATOR_H_
+#define _BUMP_ALLOCATOR_H_
+
+#include <cassert>
+#include <cstddef>
+#include <new>
+
+#include "VirtualMemory.h"
+
+
+template <class T>
+class BumpAllocator {
+public:
+   // `directory` of scratch file for FILE_BACKED pages
+   BumpAllocator(size_t reserved, size_t growSize, VirtualMemoryPages pages = VirtualMemoryPages::REGULAR, const std::string& directory = std::string());
+   ~BumpAllocator();
+
+   BumpAllocator(const BumpAllocator&) = delete;
+   BumpAllocator& operator=(const BumpAllocator&) = delete;
+
+   T* Allocate();
+   // contiguous block of `count` objects
+   T* Allocate(size_t count);
+   // objects below pinned position are never reused, even if released
+   void ReleaseUpTo(T* ptr) { current = ptr < pinned ? pinned : ptr; }
+   void Pin(T* ptr) { pinned = ptr > pinned ? ptr : pinned; }
+
+   T* GetStart() const { return (T*)virtualStart; }
+   T* GetCurrent() const { return current; }
+
+   size_t GetReservedSize() const { return virtualEnd - virtualStart; }
+   size_t GetCommittedSize() const { return physicalEnd - virtualStart; }
+   size_t GetUsedSize() const { return (unsigned char*)current - virtualStart; }
+   size_t GetCount() const { return current - GetStart(); }
+
+   // pages mode granted by OS, may be weaker than requested one
+   VirtualMemoryPages GetPages() const { return pages; }
+
+private:
+   bool Grow();
+
+   T* current;
+   T* pinned;
+   unsigned char* physicalEnd;
+   unsigned char* virtualStart;
+   unsigned char* virtualEnd;
+   size_t growSize;
+   VirtualMemoryPages pages;
+};
+
+
+#include "BumpAllocator.hpp"
+
+#endif // _BUMP_ALLOCATOR_H_
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "BumpAllocator.h"
+
+
+
+template <class T>
+BumpAllocator<T>::BumpAllocator(size_t reserved, size_t growSize, VirtualMemoryPages pages, const std::string& directory)
+   : growSize(growSize)
+   , pages(pages)
+{
+   const size_t pageSize = VirtualMemory::GetPageSize();
+   assert(growSize % pageSize == 0);
+   assert(reserved % growSize == 0);
+   // TODO: check alignment
+
+   if (pages == VirtualMemoryPages::HUGE_TRANSPARENT || pages == VirtualMemoryPages::HUGE_EXPLICIT) {
+      // grow by whole huge pages, so no huge page is ever split between committed and reserved parts
+      const size_t hugePageSize = VirtualMemory::GetHugePageSize();
+      this->growSize = (growSize + hugePageSize - 1) / hugePageSize * hugePageSize;
+      reserved = (reserved + this->growSize - 1) / this->growSize * this->growSize;
+   }
+
+   virtualStart = (unsigned char*)VirtualMemory::Reserve(reserved, this->pages, directory);
+   virtualEnd = virtualStart + reserved;
+
+   physicalEnd = virtualStart;
+   current = (T*)physicalEnd;
+   pinned = current;
+}
+
+
+template <class T>
+BumpAllocator<T>::~BumpAllocator()
+{
+   // deconstruct all constructed objects
+   T* cur = (T*)virtualStart;
+   while ((unsigned char*)(cur + 1) <= physicalEnd) {
+      cur->~T();
+      cur++;
+   }
+
+   VirtualMemory::Release(virtualStart, virtualEnd - virtualStart, pages);
+}
+
+
+template <class T>
+T* BumpAllocator<T>::Allocate()
+{
+   if ((unsigned char*)(current + 1) > physicalEnd) {
+      // not enough physical memory - need to commit more pages
+      if (!Grow()) {
+         return nullptr;
+      }
+   }
+
+   return current++;
+}
+
+
+template <class T>
+T* BumpAllocator<T>::Allocate(size_t count)
+{
+   while ((unsigned char*)(current + count) > physicalEnd) {
+      if (!Grow()) {
+         return nullptr;
+      }
+   }
+
+   T* block = current;
+   current += count;
+   return block;
+}
+
+
+template <class T>
+bool BumpAllocator<T>::Grow()
+{
+   if (physicalEnd + growSize > virtualEnd) {
+      // not enough virtual memory - can't allocate more
+      return false;
+   }
+   if (!VirtualMemory::Commit(physicalEnd, growSize, pages)) {
+      // allocation failed some how
+      return false;
+   }
+   // construct objects of T in just allocated memory, including the one which straddled old end
+   T* cur = GetStart() + (physicalEnd - virtualStart) / sizeof(T);
+   physicalEnd += growSize;
+   while ((unsigned char*)(cur + 1) <= physicalEnd) {
+      new (cur) T();
+      cur++;
+   }
+   return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#ifndef _CHECKSUM_H_
+#define _CHECKSUM_H_
+
+#include <cstddef>
+#include <cstdint>
+
+
+// 64-bit FNV-1a hash, guards file contents against corruption and torn writes
+namespace Checksum {
+
+const uint64_t initial = 14695981039346656037ULL;
+
+inline uint64_t Update(uint64_t hash, const char* data, size_t size)
+{
+   for (size_t i = 0; i < size; ++i) {
+      hash = (hash ^ (unsigned char)data[i]) * 1099511628211ULL;
+   }
+   return hash;
+}
+
+
+inline uint64_t Of(const char* data, size_t size)
+{
+   return Update(initial, data, size);
+}
+
+} // namespace Checksum
+
+
+#endif // _CHECKSUM_H_
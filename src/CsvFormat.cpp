@@ -0,0 +1,200 @@
+#include "CsvFormat.h"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cstring>
+
+
+namespace CsvFormat {
+
+Reader::~Reader ()
+{
+   if (file != File::invalidHandle) {
+      File::Close(file);
+   }
+}
+
+
+bool Reader::Open(const std::string& path, char separator, size_t chunkSize)
+{
+   assert(file == File::invalidHandle && chunkSize > 0);
+   file = File::Open(path, File::OpenMode::READ);
+   if (file == File::invalidHandle || !File::GetSize(file, remaining)) {
+      return false;
+   }
+   this->separator = separator;
+   buffer.resize(chunkSize);
+   return true;
+}
+
+
+bool Reader::Next(std::string_view& name, int& rating)
+{
+   char* begin = nullptr;
+   char* end = nullptr;
+   while (!failed && NextRecord(begin, end)) {
+      if (end != begin && end[-1] == '\r') {
+         --end;
+      }
+      if (begin == end) {
+         continue;
+      }
+
+      // quoted name is unescaped in place, it only gets shorter
+      char* nameEnd = nullptr;
+      const char* ratingBegin = nullptr;
+      if (*begin == '"') {
+         nameEnd = begin;
+         const char* in = begin + 1;
+         bool closed = false;
+         while (in < end) {
+            if (*in != '"') {
+               *nameEnd++ = *in++;
+            } else if (in + 1 < end && in[1] == '"') {
+               *nameEnd++ = '"';
+               in += 2;
+            } else {
+               closed = true;
+               ++in;
+               break;
+            }
+         }
+         if (closed && in < end && *in == separator) {
+            ratingBegin = in + 1;
+         }
+      } else {
+         for (char* c = end; c != begin; --c) {
+            if (c[-1] == separator) {
+               nameEnd = c - 1;
+               ratingBegin = c;
+               break;
+            }
+         }
+      }
+
+      if (ratingBegin && ParseRating(std::string_view(ratingBegin, end - ratingBegin), rating)) {
+         name = std::string_view(begin, nameEnd - begin);
+         return true;
+      }
+      // first line may be a header with column names, malformed number isn't taken for one
+      if (line != 1 || !ratingBegin || std::any_of(ratingBegin, (const char*)end, [] (char c) { return c >= '0' && c <= '9'; })) {
+         failed = true;
+      }
+   }
+   return false;
+}
+
+
+bool Reader::NextRecord(char*& begin, char*& end)
+{
+   // line ends at newline outside of quotes, escaped quotes toggle state twice.
+   // Quotes matter only in quoted name, others are just part of name
+   size_t scanned = position;
+   bool quoted = false;
+   for (;;) {
+      char* data = &buffer[0];
+      for (size_t i = scanned; i < size; ++i) {
+         if (data[i] == '"' && data[position] == '"') {
+            quoted = !quoted;
+         } else if (data[i] == '\n' && !quoted) {
+            begin = data + position;
+            end = data + i;
+            position = i + 1;
+            ++line;
+            return true;
+         }
+      }
+      scanned = size - position;
+
+      if (ended) {
+         if (position == size) {
+            return false;
+         }
+         begin = data + position;
+         end = data + size;
+         position = size;
+         ++line;
+         return true;
+      }
+      if (!Fill()) {
+         failed = true;
+         return false;
+      }
+   }
+}
+
+
+bool Reader::Fill (void)
+{
+   // unparsed tail is moved to the front, buffer grows only if a single line doesn't fit into it
+   if (position != 0) {
+      memmove(&buffer[0], &buffer[position], size - position);
+      size -= position;
+      position = 0;
+   }
+   if (size == buffer.size()) {
+      buffer.resize(buffer.size() * 2);
+   }
+   size_t read = File::Read(file, &buffer[size], buffer.size() - size);
+   if (read == 0) {
+      // read error looks like the end of file, file size tells them apart
+      ended = true;
+      return remaining == 0;
+   }
+   size += read;
+   remaining -= read < remaining ? read : remaining;
+   return true;
+}
+
+
+bool ParseRating(std::string_view text, int& rating)
+{
+   while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+      text.remove_prefix(1);
+   }
+   while (!text.empty() && (text.back() == ' ' || text.back() == '\t')) {
+      text.remove_suffix(1);
+   }
+   bool negative = !text.empty() && text.front() == '-';
+   if (!text.empty() && (text.front() == '-' || text.front() == '+')) {
+      text.remove_prefix(1);
+   }
+   if (text.empty()) {
+      return false;
+   }
+
+   const long long limit = negative ? -(long long)INT_MIN : INT_MAX;
+   long long value = 0;
+   for (char c : text) {
+      if (c < '0' || c > '9') {
+         return false;
+      }
+      value = value * 10 + (c - '0');
+      if (value > limit) {
+         return false;
+      }
+   }
+   rating = (int)(negative ? -value : value);
+   return true;
+}
+
+
+void AppendName(std::string& out, std::string_view name, char separator)
+{
+   const char special[] = { separator, '"', '\r', '\n' };
+   if (name.find_first_of(std::string_view(special, sizeof(special))) == std::string_view::npos) {
+      out.append(name);
+      return;
+   }
+   out.push_back('"');
+   for (char c : name) {
+      if (c == '"') {
+         out.push_back('"');
+      }
+      out.push_back(c);
+   }
+   out.push_back('"');
+}
+
+} // namespace CsvFormat
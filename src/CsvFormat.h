@@ -0,0 +1,60 @@
+#pragma once
+#ifndef _CSV_FORMAT_H_
+#define _CSV_FORMAT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "File.h"
+
+
+// Text file of players, one `name<separator>rating` line each - CSV with ',' or TSV with '\t'.
+// Name may be quoted with '"', quotes inside are doubled; unquoted name ends at the last separator of line,
+// so it may contain separators too. Lines end with "\n" or "\r\n", blank lines are skipped.
+// First line is a header if its rating column has no digits
+namespace CsvFormat {
+
+// reads file in chunks, memory doesn't depend on file size - only on its longest line
+class Reader {
+public:
+   Reader(void) = default;
+   Reader(const Reader&) = delete;
+   Reader& operator=(const Reader&) = delete;
+   ~Reader();
+
+   bool Open(const std::string& path, char separator, size_t chunkSize = 1 << 20);
+   // next player, name points into read buffer and is valid until next call.
+   // Returns false at the end of file or on error, see IsFailed
+   bool Next(std::string_view& name, int& rating);
+   // malformed line or I/O error, GetLine tells which line it was
+   bool IsFailed(void) const { return failed; }
+   size_t GetLine(void) const { return line; }
+
+private:
+   bool NextRecord(char*& begin, char*& end);
+   bool Fill(void);
+
+   File::Handle file = File::invalidHandle;
+   char         separator = ',';
+   bool         failed = false;
+   bool         ended = false;  // whole file is in buffer
+   uint64_t     remaining = 0;  // bytes of file not read yet
+   size_t       line = 0;
+
+   std::string buffer;
+   size_t      position = 0; // start of unparsed data
+   size_t      size = 0;     // end of data read into buffer
+};
+
+
+// strict decimal integer, surrounding spaces are allowed
+bool ParseRating(std::string_view text, int& rating);
+// appends name field, quoted if it contains separator, quote or line break
+void AppendName(std::string& out, std::string_view name, char separator);
+
+} // namespace CsvFormat
+
+
+#endif // _CSV_FORMAT_H_
@@ -0,0 +1,104 @@
+#include "EpochReclaimer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <thread>
+
+
+EpochReclaimer::EpochReclaimer(size_t maxConcurrentReaders)
+   : slots(maxConcurrentReaders != 0 ? maxConcurrentReaders : std::max(8U, 2 * std::thread::hardware_concurrency()))
+{}
+
+
+EpochReclaimer::ReadGuard::ReadGuard(EpochReclaimer& reclaimer)
+   : reclaimer(&reclaimer)
+   , slot(reclaimer.Enter())
+{}
+
+
+EpochReclaimer::ReadGuard::ReadGuard(ReadGuard&& other) noexcept
+   : reclaimer(other.reclaimer)
+   , slot(other.slot)
+{
+   other.reclaimer = nullptr;
+}
+
+
+auto EpochReclaimer::ReadGuard::operator=(ReadGuard&& other) noexcept -> ReadGuard&
+{
+   if (this != &other) {
+      if (reclaimer) {
+         reclaimer->Leave(slot);
+      }
+      reclaimer = other.reclaimer;
+      slot = other.slot;
+      other.reclaimer = nullptr;
+   }
+   return *this;
+}
+
+
+EpochReclaimer::ReadGuard::~ReadGuard()
+{
+   if (reclaimer) {
+      reclaimer->Leave(slot);
+   }
+}
+
+
+size_t EpochReclaimer::Enter()
+{
+   // start probing from thread specific slot, so the same threads don't collide each time
+   size_t slot = std::hash<std::thread::id>()(std::this_thread::get_id()) % slots.size();
+   for (;;) {
+      // epoch may be advanced between load and slot claim - older epoch only makes writer more conservative.
+      // Slot claim is sequentially consistent, so it's ordered before any read of published data
+      uint64_t current = epoch.load();
+      uint64_t expected = 0;
+      if (slots[slot].epoch.compare_exchange_strong(expected, current)) {
+         return slot;
+      }
+      slot = (slot + 1) % slots.size();
+   }
+}
+
+
+void EpochReclaimer::Leave(size_t slot)
+{
+   slots[slot].epoch.store(0, std::memory_order_release);
+}
+
+
+void EpochReclaimer::Retire(std::shared_ptr<const void> object)
+{
+   // readers entering after epoch advance can't observe object, as it's unlinked before
+   retired.push_back(Retired{ epoch.fetch_add(1), std::move(object) });
+   Reclaim();
+}
+
+
+bool EpochReclaimer::Reclaim()
+{
+   if (retired.empty()) {
+      return true;
+   }
+   uint64_t minReaderEpoch = GetMinReaderEpoch();
+   while (!retired.empty() && retired.front().epoch < minReaderEpoch) {
+      retired.pop_front();
+   }
+   return retired.empty();
+}
+
+
+uint64_t EpochReclaimer::GetMinReaderEpoch() const
+{
+   uint64_t minEpoch = UINT64_MAX;
+   for (const auto& slot : slots) {
+      uint64_t readerEpoch = slot.epoch.load();
+      if (readerEpoch != 0) {
+         minEpoch = std::min(minEpoch, readerEpoch);
+      }
+   }
+   return minEpoch;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#ifndef _EPOCH_RECLAIMER_H_
+#define _EPOCH_RECLAIMER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+
+// Epoch based reclamation for single writer and lock-free readers.
+// Readers pin current epoch for the time of reading, writer retires objects it unlinked from
+// readers view and those are released only after all readers which could observe them have left.
+class EpochReclaimer {
+public:
+   explicit EpochReclaimer(size_t maxConcurrentReaders = 0); // 0 - two per hardware thread
+
+   EpochReclaimer(const EpochReclaimer&) = delete;
+   EpochReclaimer& operator=(const EpochReclaimer&) = delete;
+
+   // pins epoch while alive, empty guard pins nothing
+   class ReadGuard {
+   public:
+      ReadGuard() = default;
+      explicit ReadGuard(EpochReclaimer& reclaimer);
+      ReadGuard(ReadGuard&& other) noexcept;
+      ReadGuard& operator=(ReadGuard&& other) noexcept;
+      ~ReadGuard();
+
+   private:
+      EpochReclaimer* reclaimer = nullptr;
+      size_t          slot = 0;
+   };
+
+   // writer only: object is released once no reader can observe it, so it has to be unlinked before
+   void Retire(std::shared_ptr<const void> object);
+   // writer only: releases retired objects not observable by active readers, returns whether all were released
+   bool Reclaim();
+
+   // oldest epoch pinned by active readers, UINT64_MAX if there are none
+   uint64_t GetMinReaderEpoch() const;
+   uint64_t GetEpoch() const { return epoch.load(); }
+   size_t GetRetiredCount() const { return retired.size(); }
+
+private:
+   size_t Enter();
+   void Leave(size_t slot);
+
+   // one reader per cache line, so readers don't contend with each other
+   struct alignas(64) ReaderSlot {
+      std::atomic<uint64_t> epoch{ 0 }; // 0 - free slot
+   };
+
+   struct Retired {
+      uint64_t                    epoch;
+      std::shared_ptr<const void> object;
+   };
+
+   std::atomic<uint64_t>   epoch{ 1 };
+   std::vector<ReaderSlot> slots;
+   std::deque<Retired>     retired; // in retirement order, so epochs are ascending
+};
+
+
+#endif // _EPOCH_RECLAIMER_H_
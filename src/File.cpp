@@ -0,0 +1,306 @@
+#include "File.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+
+namespace File {
+
+#ifdef _WIN32
+
+Handle Open(const std::string& path, OpenMode mode)
+{
+   DWORD access = mode == OpenMode::READ ? GENERIC_READ : GENERIC_WRITE;
+   DWORD disposition = mode == OpenMode::READ ? OPEN_EXISTING : (mode == OpenMode::CREATE ? CREATE_ALWAYS : OPEN_ALWAYS);
+   HANDLE file = CreateFileA(path.c_str(), access, FILE_SHARE_READ, NULL, disposition, FILE_ATTRIBUTE_NORMAL, NULL);
+   if (file == INVALID_HANDLE_VALUE) {
+      return invalidHandle;
+   }
+   if (mode == OpenMode::APPEND) {
+      LARGE_INTEGER zero = {};
+      SetFilePointerEx(file, zero, NULL, FILE_END);
+   }
+   return (Handle)file;
+}
+
+
+void Close(Handle file)
+{
+   CloseHandle((HANDLE)file);
+}
+
+
+bool Write(Handle file, const void* data, size_t size)
+{
+   const char* bytes = (const char*)data;
+   while (size != 0) {
+      DWORD chunk = size > (1U << 30) ? (1U << 30) : (DWORD)size;
+      DWORD written = 0;
+      if (!WriteFile((HANDLE)file, bytes, chunk, &written, NULL)) {
+         return false;
+      }
+      bytes += written;
+      size -= written;
+   }
+   return true;
+}
+
+
+size_t Read(Handle file, void* data, size_t size)
+{
+   DWORD chunk = size > (1U << 30) ? (1U << 30) : (DWORD)size;
+   DWORD read = 0;
+   if (!ReadFile((HANDLE)file, data, chunk, &read, NULL)) {
+      return 0;
+   }
+   return read;
+}
+
+
+bool Sync(Handle file)
+{
+   return FlushFileBuffers((HANDLE)file) != 0;
+}
+
+
+bool Truncate(Handle file, uint64_t size)
+{
+   LARGE_INTEGER position;
+   position.QuadPart = (LONGLONG)size;
+   return SetFilePointerEx((HANDLE)file, position, NULL, FILE_BEGIN) && SetEndOfFile((HANDLE)file);
+}
+
+
+bool GetSize(Handle file, uint64_t& size)
+{
+   LARGE_INTEGER fileSize;
+   if (!GetFileSizeEx((HANDLE)file, &fileSize)) {
+      return false;
+   }
+   size = (uint64_t)fileSize.QuadPart;
+   return true;
+}
+
+
+const void* MapReadOnly(const std::string& path, size_t& size)
+{
+   Handle file = Open(path, OpenMode::READ);
+   if (file == invalidHandle) {
+      return nullptr;
+   }
+   uint64_t fileSize = 0;
+   const void* data = nullptr;
+   // empty file can't be mapped
+   if (GetSize(file, fileSize) && fileSize != 0 && fileSize <= SIZE_MAX) {
+      HANDLE mapping = CreateFileMappingA((HANDLE)file, NULL, PAGE_READONLY, 0, 0, NULL);
+      if (mapping != NULL) {
+         // view keeps mapping alive after its handle is closed
+         data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+         CloseHandle(mapping);
+      }
+   }
+   Close(file);
+   size = (size_t)fileSize;
+   return data;
+}
+
+
+void Unmap(const void* data, size_t /*size*/)
+{
+   UnmapViewOfFile(data);
+}
+
+
+bool Exists(const std::string& path)
+{
+   return GetFileAttributesA(path.c_str()) != INVALID_FILE_ATTRIBUTES;
+}
+
+
+bool Rename(const std::string& from, const std::string& to)
+{
+   return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+}
+
+
+bool Remove(const std::string& path)
+{
+   return DeleteFileA(path.c_str()) != 0;
+}
+
+#else
+
+Handle Open(const std::string& path, OpenMode mode)
+{
+   int flags = O_RDONLY;
+   if (mode == OpenMode::CREATE) {
+      flags = O_WRONLY | O_CREAT | O_TRUNC;
+   } else if (mode == OpenMode::APPEND) {
+      flags = O_WRONLY | O_CREAT | O_APPEND;
+   }
+   int fd = open(path.c_str(), flags | O_CLOEXEC, 0644);
+   return fd >= 0 ? (Handle)fd : invalidHandle;
+}
+
+
+void Close(Handle file)
+{
+   close((int)file);
+}
+
+
+bool Write(Handle file, const void* data, size_t size)
+{
+   const char* bytes = (const char*)data;
+   while (size != 0) {
+      ssize_t written = write((int)file, bytes, size);
+      if (written < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         return false;
+      }
+      bytes += written;
+      size -= (size_t)written;
+   }
+   return true;
+}
+
+
+size_t Read(Handle file, void* data, size_t size)
+{
+   for (;;) {
+      ssize_t read = ::read((int)file, data, size);
+      if (read >= 0) {
+         return (size_t)read;
+      }
+      if (errno != EINTR) {
+         return 0;
+      }
+   }
+}
+
+
+bool Sync(Handle file)
+{
+   return fsync((int)file) == 0;
+}
+
+
+bool Truncate(Handle file, uint64_t size)
+{
+   return ftruncate((int)file, (off_t)size) == 0;
+}
+
+
+bool GetSize(Handle file, uint64_t& size)
+{
+   struct stat info;
+   if (fstat((int)file, &info) != 0) {
+      return false;
+   }
+   size = (uint64_t)info.st_size;
+   return true;
+}
+
+
+const void* MapReadOnly(const std::string& path, size_t& size)
+{
+   Handle file = Open(path, OpenMode::READ);
+   if (file == invalidHandle) {
+      return nullptr;
+   }
+   uint64_t fileSize = 0;
+   void* data = MAP_FAILED;
+   if (GetSize(file, fileSize) && fileSize != 0 && fileSize <= SIZE_MAX) {
+      data = mmap(nullptr, (size_t)fileSize, PROT_READ, MAP_SHARED, (int)file, 0);
+   }
+   Close(file);
+   size = (size_t)fileSize;
+   return data != MAP_FAILED ? data : nullptr;
+}
+
+
+void Unmap(const void* data, size_t size)
+{
+   munmap(const_cast<void*>(data), size);
+}
+
+
+bool Exists(const std::string& path)
+{
+   return access(path.c_str(), F_OK) == 0;
+}
+
+
+bool Rename(const std::string& from, const std::string& to)
+{
+   if (rename(from.c_str(), to.c_str()) != 0) {
+      return false;
+   }
+   // new directory entry is durable only once directory itself is synced
+   size_t slash = to.find_last_of('/');
+   std::string directory = slash == std::string::npos ? "." : (slash == 0 ? "/" : to.substr(0, slash));
+   int fd = open(directory.c_str(), O_RDONLY | O_CLOEXEC);
+   if (fd < 0) {
+      return false;
+   }
+   bool synced = fsync(fd) == 0;
+   close(fd);
+   return synced;
+}
+
+
+bool Remove(const std::string& path)
+{
+   return unlink(path.c_str()) == 0;
+}
+
+#endif
+
+
+
+bool GetSize(const std::string& path, uint64_t& size)
+{
+   Handle file = Open(path, OpenMode::READ);
+   if (file == invalidHandle) {
+      return false;
+   }
+   bool got = GetSize(file, size);
+   Close(file);
+   return got;
+}
+
+
+bool ReadAll(const std::string& path, std::string& content)
+{
+   Handle file = Open(path, OpenMode::READ);
+   if (file == invalidHandle) {
+      return false;
+   }
+   uint64_t size = 0;
+   bool read = GetSize(file, size) && size <= SIZE_MAX;
+   if (read) {
+      content.resize((size_t)size);
+      size_t done = 0;
+      while (done < content.size()) {
+         size_t chunk = Read(file, &content[done], content.size() - done);
+         if (chunk == 0) {
+            read = false;
+            break;
+         }
+         done += chunk;
+      }
+   }
+   Close(file);
+   return read;
+}
+
+} // namespace File
@@ -0,0 +1,51 @@
+#pragma once
+#ifndef _FILE_H_
+#define _FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+// Unbuffered files with explicit durability control, thin layer over OS API
+namespace File {
+
+using Handle = intptr_t;
+const Handle invalidHandle = -1;
+
+enum class OpenMode : unsigned char {
+   READ = 0,   // existing file
+   CREATE = 1, // new empty file for writing, existing one is truncated
+   APPEND = 2, // writing at the end, file is created if it doesn't exist
+};
+
+Handle Open(const std::string& path, OpenMode mode);
+void Close(Handle file);
+
+// writes whole buffer
+bool Write(Handle file, const void* data, size_t size);
+// reads up to `size` bytes, returns number of bytes read - 0 at the end of file
+size_t Read(Handle file, void* data, size_t size);
+// waits until written data reaches storage
+bool Sync(Handle file);
+// cuts file opened for appending to `size` bytes, following writes go to its new end
+bool Truncate(Handle file, uint64_t size);
+bool GetSize(Handle file, uint64_t& size);
+bool GetSize(const std::string& path, uint64_t& size);
+// whole file contents
+bool ReadAll(const std::string& path, std::string& content);
+
+// maps whole file read-only, nullptr on failure. Pages are shared with page cache and other processes
+// mapping the same file; mapping isn't affected when file is replaced by Rename
+const void* MapReadOnly(const std::string& path, size_t& size);
+void Unmap(const void* data, size_t size);
+
+bool Exists(const std::string& path);
+// atomically replaces `to`, which is durable once function returns
+bool Rename(const std::string& from, const std::string& to);
+bool Remove(const std::string& path);
+
+} // namespace File
+
+
+#endif // _FILE_H_
@@ -0,0 +1,88 @@
+#include "LeaderboardFormat.h"
+
+#include <cassert>
+#include <cstring>
+
+#include "Checksum.h"
+#include "File.h"
+
+
+namespace LeaderboardFormat {
+
+uint64_t HashName(const char* name, size_t size)
+{
+   return Checksum::Of(name, size);
+}
+
+
+template <class T>
+static bool WriteArray(File::Handle file, const std::vector<T>& items)
+{
+   return File::Write(file, items.data(), items.size() * sizeof(T));
+}
+
+
+bool Write(const std::string& path, uint64_t version, const std::vector<std::pair<const std::string*, int>>& players)
+{
+   const size_t count = players.size();
+   assert((uint64_t)count < UINT32_MAX);
+
+   Header header = {};
+   memcpy(header.magic, magic, sizeof(magic));
+   header.formatVersion = formatVersion;
+   header.recordSize = sizeof(Record);
+   header.version = version;
+   header.playersCount = count;
+   header.indexSize = 2;
+   while (header.indexSize < 2 * count) {
+      header.indexSize *= 2;
+   }
+
+   std::vector<Record> records(count);
+   std::vector<uint32_t> index((size_t)header.indexSize, 0);
+   const uint64_t mask = header.indexSize - 1;
+   for (size_t i = 0; i < count; ++i) {
+      const std::string& name = *players[i].first;
+      uint64_t hash = HashName(name.data(), name.size());
+      Record& record = records[i];
+      record.nameOffset = header.namesSize;
+      record.nameSize = (uint32_t)name.size();
+      record.nameHash = (uint32_t)(hash >> 32);
+      record.rating = players[i].second;
+      record.ranking = i != 0 && players[i - 1].second == record.rating ? records[i - 1].ranking : (int32_t)(i + 1);
+      header.namesSize += name.size();
+
+      uint64_t bucket = hash & mask;
+      while (index[(size_t)bucket] != 0) {
+         bucket = (bucket + 1) & mask;
+      }
+      index[(size_t)bucket] = (uint32_t)(i + 1);
+   }
+
+   const std::string tempPath = path + ".tmp";
+   File::Handle file = File::Open(tempPath, File::OpenMode::CREATE);
+   if (file == File::invalidHandle) {
+      return false;
+   }
+   bool written = File::Write(file, &header, sizeof(header)) && WriteArray(file, records) && WriteArray(file, index);
+
+   // names go through buffer, one write per player would dominate export
+   std::string names;
+   names.reserve(1 << 20);
+   for (size_t i = 0; i < count && written; ++i) {
+      names.append(*players[i].first);
+      if (names.size() >= (1 << 20) || i + 1 == count) {
+         written = File::Write(file, names.data(), names.size());
+         names.clear();
+      }
+   }
+   written = written && File::Sync(file);
+   File::Close(file);
+   if (written && File::Rename(tempPath, path)) {
+      return true;
+   }
+   File::Remove(tempPath);
+   return false;
+}
+
+} // namespace LeaderboardFormat
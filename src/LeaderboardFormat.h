@@ -0,0 +1,52 @@
+#pragma once
+#ifndef _LEADERBOARD_FORMAT_H_
+#define _LEADERBOARD_FORMAT_H_
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+// Immutable leaderboard file, read in place through memory mapping. Native little-endian layout:
+//   Header
+//   Record[playersCount] - players ordered by ranking, equal ones by name
+//   uint32[indexSize]    - open addressing hash index of names: record position + 1, 0 for empty bucket
+//   char[namesSize]      - names of all players one after another
+// Sections are adjacent, so their offsets follow from header and file size has to match exactly
+namespace LeaderboardFormat {
+
+struct Header {
+   char     magic[8];
+   uint32_t formatVersion;
+   uint32_t recordSize; // sizeof(Record) of writer
+   uint64_t version;    // id of DB version
+   uint64_t playersCount;
+   uint64_t indexSize;  // power of 2, at least twice players count
+   uint64_t namesSize;
+};
+
+struct Record {
+   uint64_t nameOffset; // in names section
+   uint32_t nameSize;
+   uint32_t nameHash;   // high half of name hash, compared before names on lookups
+   int32_t  rating;
+   int32_t  ranking;
+};
+
+static_assert(sizeof(Header) == 48, "header layout is part of file format");
+static_assert(sizeof(Record) == 24, "record layout is part of file format");
+
+const char     magic[8] = { 'P', 'R', 'D', 'B', 'L', 'B', 'R', 'D' };
+const uint32_t formatVersion = 1;
+
+// bucket of name index to start probing from and value stored in Record::nameHash
+uint64_t HashName(const char* name, size_t size);
+
+// players sorted by ranking, then by name. File at `path` is replaced once new one is complete and durable
+bool Write(const std::string& path, uint64_t version, const std::vector<std::pair<const std::string*, int>>& players);
+
+} // namespace LeaderboardFormat
+
+
+#endif // _LEADERBOARD_FORMAT_H_
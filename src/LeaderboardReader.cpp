@@ -0,0 +1,163 @@
+#include "LeaderboardReader.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <utility>
+
+#include "File.h"
+#include "LeaderboardFormat.h"
+
+
+using LeaderboardFormat::Header;
+using LeaderboardFormat::Record;
+
+
+LeaderboardReader::LeaderboardReader (LeaderboardReader&& other) noexcept
+{
+   *this = std::move(other);
+}
+
+
+LeaderboardReader& LeaderboardReader::operator= (LeaderboardReader&& other) noexcept
+{
+   if (this != &other) {
+      Close();
+      std::swap(data, other.data);
+      std::swap(size, other.size);
+      std::swap(header, other.header);
+      std::swap(records, other.records);
+      std::swap(index, other.index);
+      std::swap(names, other.names);
+   }
+   return *this;
+}
+
+
+LeaderboardReader::~LeaderboardReader ()
+{
+   Close();
+}
+
+
+bool LeaderboardReader::Open(const std::string& path)
+{
+   Close();
+   size_t mappedSize = 0;
+   const void* mapped = File::MapReadOnly(path, mappedSize);
+   if (!mapped) {
+      return false;
+   }
+
+   // only header is checked - records are read in place and validated when used
+   const Header* fileHeader = (const Header*)mapped;
+   bool valid = mappedSize >= sizeof(Header)
+      && memcmp(fileHeader->magic, LeaderboardFormat::magic, sizeof(LeaderboardFormat::magic)) == 0
+      && fileHeader->formatVersion == LeaderboardFormat::formatVersion
+      && fileHeader->recordSize == sizeof(Record);
+   if (valid) {
+      const uint64_t count = fileHeader->playersCount;
+      const uint64_t indexSize = fileHeader->indexSize;
+      const uint64_t available = mappedSize - sizeof(Header);
+      // every player takes a record and at least two index buckets
+      valid = count < UINT32_MAX && count <= available / (sizeof(Record) + 2 * sizeof(uint32_t))
+         && indexSize > count && (indexSize & (indexSize - 1)) == 0 && indexSize <= available / sizeof(uint32_t)
+         && fileHeader->namesSize <= available && count * sizeof(Record) + indexSize * sizeof(uint32_t) + fileHeader->namesSize == available;
+   }
+   if (!valid) {
+      File::Unmap(mapped, mappedSize);
+      return false;
+   }
+
+   data = mapped;
+   size = mappedSize;
+   header = fileHeader;
+   records = fileHeader + 1;
+   index = (const uint32_t*)((const Record*)records + fileHeader->playersCount);
+   names = (const char*)(index + fileHeader->indexSize);
+   return true;
+}
+
+
+void LeaderboardReader::Close (void)
+{
+   if (data) {
+      File::Unmap(data, size);
+   }
+   data = header = records = nullptr;
+   size = 0;
+   index = nullptr;
+   names = nullptr;
+}
+
+
+auto LeaderboardReader::GetVersion (void) const -> Version
+{
+   return data ? ((const Header*)header)->version : 0;
+}
+
+
+size_t LeaderboardReader::GetPlayersCount (void) const
+{
+   return data ? (size_t)((const Header*)header)->playersCount : 0;
+}
+
+
+int LeaderboardReader::GetPlayerRank(std::string_view playerName) const
+{
+   auto row = FindPlayer(playerName);
+   return row ? row->ranking : 0;
+}
+
+
+auto LeaderboardReader::FindPlayer(std::string_view playerName) const -> std::optional<Row>
+{
+   if (!data) {
+      return std::nullopt;
+   }
+   const Header& fileHeader = *(const Header*)header;
+   const uint64_t hash = LeaderboardFormat::HashName(playerName.data(), playerName.size());
+   const uint64_t mask = fileHeader.indexSize - 1;
+   // index always has empty buckets, probes are bounded anyway in case file is damaged
+   uint64_t bucket = hash & mask;
+   for (uint64_t probe = 0; probe < fileHeader.indexSize && index[bucket] != 0; ++probe, bucket = (bucket + 1) & mask) {
+      size_t position = index[bucket] - 1;
+      if (position >= fileHeader.playersCount) {
+         break;
+      }
+      const Record& record = ((const Record*)records)[position];
+      if (record.nameHash == (uint32_t)(hash >> 32) && GetRowAt(position).name == playerName) {
+         return GetRowAt(position);
+      }
+   }
+   return std::nullopt;
+}
+
+
+auto LeaderboardReader::GetRowAt(size_t position) const -> Row
+{
+   assert(position < GetPlayersCount());
+   const Header& fileHeader = *(const Header*)header;
+   const Record& record = ((const Record*)records)[position];
+   std::string_view name;
+   if (record.nameOffset <= fileHeader.namesSize && record.nameSize <= fileHeader.namesSize - record.nameOffset) {
+      name = std::string_view(names + record.nameOffset, record.nameSize);
+   }
+   return Row{ name, record.rating, record.ranking };
+}
+
+
+auto LeaderboardReader::GetPlayersPage(size_t offset, size_t count) const -> std::vector<Row>
+{
+   std::vector<Row> rows;
+   const size_t playersCount = GetPlayersCount();
+   if (offset >= playersCount) {
+      return rows;
+   }
+   count = std::min(count, playersCount - offset);
+   rows.reserve(count);
+   for (size_t i = offset; i < offset + count; ++i) {
+      rows.push_back(GetRowAt(i));
+   }
+   return rows;
+}
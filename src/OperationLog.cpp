@@ -0,0 +1,184 @@
+#include "OperationLog.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstring>
+
+#include "Checksum.h"
+#include "Varint.h"
+
+
+static const char     magic[8] = { 'P', 'R', 'D', 'B', 'O', 'L', 'O', 'G' };
+static const uint32_t formatVersion = 2;
+static const size_t   headerSize = sizeof(magic) + 4 + 8 + 8;
+static const size_t   sizeFieldSize = 4;
+static const size_t   hashFieldSize = 8;
+
+static std::atomic<bool> failNextSync{ false };
+
+
+OperationLog::~OperationLog ()
+{
+   if (file != File::invalidHandle) {
+      File::Close(file);
+   }
+}
+
+
+bool OperationLog::Create(const std::string& path, uint64_t checkpoint, PlayerRankingDB::Version lastVersion)
+{
+   if (file != File::invalidHandle) {
+      File::Close(file);
+      file = File::invalidHandle;
+   }
+   buffer.clear();
+
+   std::string header(magic, sizeof(magic));
+   Varint::AppendFixed(header, formatVersion, 4);
+   Varint::AppendFixed(header, checkpoint, 8);
+   Varint::AppendFixed(header, lastVersion, 8);
+
+   // header is made durable before replacing previous log, so there's always a valid one
+   const std::string tempPath = path + ".tmp";
+   File::Handle temp = File::Open(tempPath, File::OpenMode::CREATE);
+   if (temp == File::invalidHandle) {
+      return false;
+   }
+   bool written = File::Write(temp, header.data(), header.size()) && File::Sync(temp);
+   File::Close(temp);
+   if (!written || !File::Rename(tempPath, path)) {
+      File::Remove(tempPath);
+      return false;
+   }
+
+   file = File::Open(path, File::OpenMode::APPEND);
+   size = header.size();
+   syncedSize = size;
+   return file != File::invalidHandle;
+}
+
+
+void OperationLog::Append(const Record& record)
+{
+   assert(file != File::invalidHandle);
+   const size_t start = buffer.size();
+   Varint::AppendFixed(buffer, 0, sizeFieldSize);
+
+   buffer.push_back((char)record.type);
+   if (record.type == RecordType::ROLLBACK) {
+      Varint::Append(buffer, record.version);
+   }
+   Varint::Append(buffer, record.commands.size());
+   for (const auto& command : record.commands) {
+      Varint::Append(buffer, command.playerName.size());
+      buffer.append(command.playerName);
+      Varint::Append(buffer, command.playerRating ? Varint::ZigZag(*command.playerRating) + 1 : 0);
+   }
+
+   const size_t payloadSize = buffer.size() - start - sizeFieldSize;
+   for (size_t i = 0; i < sizeFieldSize; ++i) {
+      buffer[start + i] = (char)(payloadSize >> (8 * i));
+   }
+   Varint::AppendFixed(buffer, Checksum::Of(&buffer[start + sizeFieldSize], payloadSize), hashFieldSize);
+   size += buffer.size() - start;
+}
+
+
+bool OperationLog::Sync (void)
+{
+   if (file == File::invalidHandle) {
+      return false;
+   }
+   bool synced = File::Write(file, buffer.data(), buffer.size()) && !failNextSync.exchange(false) && File::Sync(file);
+   buffer.clear();
+   if (synced) {
+      syncedSize = size;
+      return true;
+   }
+
+   // failed records may be partially written or even durable, but their writes are reverted, so they must not be replayed
+   if (!File::Truncate(file, syncedSize) || !File::Sync(file)) {
+      File::Close(file);
+      file = File::invalidHandle;
+   }
+   size = syncedSize;
+   return false;
+}
+
+
+void OperationLog::FailNextSync (void)
+{
+   failNextSync = true;
+}
+
+
+static bool DecodeRecord(const char* data, const char* end, OperationLog::Record& record)
+{
+   if (data == end) {
+      return false;
+   }
+   record.type = (OperationLog::RecordType)*data++;
+   uint64_t value;
+   if (record.type == OperationLog::RecordType::ROLLBACK) {
+      if (!(data = Varint::Decode(data, end, value))) {
+         return false;
+      }
+      record.version = value;
+   } else if (record.type != OperationLog::RecordType::BATCH) {
+      return false;
+   }
+
+   uint64_t count;
+   // every command takes 2 bytes at least
+   if (!(data = Varint::Decode(data, end, count)) || count > (uint64_t)(end - data) / 2) {
+      return false;
+   }
+   record.commands.resize((size_t)count);
+   for (auto& command : record.commands) {
+      if (!(data = Varint::Decode(data, end, value)) || value > (uint64_t)(end - data)) {
+         return false;
+      }
+      command.playerName.assign(data, (size_t)value);
+      data += value;
+      if (!(data = Varint::Decode(data, end, value)) || value > (uint64_t)UINT32_MAX + 1) {
+         return false;
+      }
+      if (value != 0) {
+         command.playerRating = (int)Varint::UnZigZag(value - 1);
+      }
+   }
+   return data == end;
+}
+
+
+bool OperationLog::Read(const std::string& path, uint64_t& checkpoint, PlayerRankingDB::Version& lastVersion, std::vector<Record>& records, bool& complete)
+{
+   std::string content;
+   if (!File::ReadAll(path, content) || content.size() < headerSize) {
+      return false;
+   }
+   const char* data = content.data();
+   const char* end = data + content.size();
+   if (memcmp(data, magic, sizeof(magic)) != 0 || Varint::DecodeFixed(data + 8, 4) != formatVersion) {
+      return false;
+   }
+   checkpoint = Varint::DecodeFixed(data + 12, 8);
+   lastVersion = Varint::DecodeFixed(data + 20, 8);
+
+   data += headerSize;
+   while ((size_t)(end - data) >= sizeFieldSize + hashFieldSize) {
+      size_t payloadSize = (size_t)Varint::DecodeFixed(data, sizeFieldSize);
+      if (payloadSize > (size_t)(end - data) - sizeFieldSize - hashFieldSize) {
+         break;
+      }
+      const char* payload = data + sizeFieldSize;
+      Record record;
+      if (Checksum::Of(payload, payloadSize) != Varint::DecodeFixed(payload + payloadSize, hashFieldSize) || !DecodeRecord(payload, payload + payloadSize, record)) {
+         break;
+      }
+      records.push_back(std::move(record));
+      data = payload + payloadSize + hashFieldSize;
+   }
+   complete = data == end;
+   return true;
+}
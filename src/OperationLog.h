@@ -0,0 +1,64 @@
+#pragma once
+#ifndef _OPERATION_LOG_H_
+#define _OPERATION_LOG_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "File.h"
+#include "PlayerRankingDB.h"
+
+
+// Append-only log of DB writes following a checkpoint. File layout, fixed-size integers are little-endian:
+//   header: magic "PRDBOLOG", uint32 format version, uint64 number of checkpoint log follows,
+//           uint64 last version id given before log was started
+//   records: uint32 payload size, payload, uint64 FNV-1a hash of payload
+// Payload is record type byte followed by varints: version id for ROLLBACK, number of commands and
+// commands - name size, name, zigzag rating + 1 or 0 for no rating.
+// Records are made durable in groups by Sync, torn or corrupted tail ends the log on reading
+class OperationLog {
+public:
+   enum class RecordType : unsigned char {
+      BATCH = 1,    // commands applied by ApplyBatch
+      ROLLBACK = 2, // RollbackTo(version), no commands
+   };
+
+   struct Record {
+      RecordType                                 type = RecordType::BATCH;
+      PlayerRankingDB::Version                   version = 0;
+      std::vector<PlayerRankingDB::WriteCommand> commands;
+   };
+
+   OperationLog(void) = default;
+   OperationLog(const OperationLog&) = delete;
+   OperationLog& operator=(const OperationLog&) = delete;
+   ~OperationLog();
+
+   // starts empty log following given checkpoint, atomically replacing file at `path`
+   bool Create(const std::string& path, uint64_t checkpoint, PlayerRankingDB::Version lastVersion);
+   bool IsOpen(void) const { return file != File::invalidHandle; }
+   // bytes in log file, synced or not
+   uint64_t GetSize(void) const { return size; }
+
+   // record is buffered until Sync
+   void Append(const Record& record);
+   // writes buffered records and waits until they reach storage. On I/O error returns false and cuts
+   // records of this sync off the file, so they aren't read back. Log is closed if even that fails
+   bool Sync(void);
+   // makes the next Sync of any log fail once its records are written, for testing failure handling
+   static void FailNextSync(void);
+
+   // reads all complete records. Returns false if there's no valid log at `path`,
+   // `complete` tells whether log ends with a complete record
+   static bool Read(const std::string& path, uint64_t& checkpoint, PlayerRankingDB::Version& lastVersion, std::vector<Record>& records, bool& complete);
+
+private:
+   File::Handle file = File::invalidHandle;
+   std::string  buffer;
+   uint64_t     size = 0;
+   uint64_t     syncedSize = 0;
+};
+
+
+#endif // _OPERATION_LOG_H_
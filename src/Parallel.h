@@ -0,0 +1,78 @@
+#pragma once
+#ifndef _PARALLEL_H_
+#define _PARALLEL_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+
+namespace Parallel {
+
+// requested threads count, or one per hardware thread for 0
+inline size_t GetThreadsCount(size_t requested = 0)
+{
+   if (requested != 0) {
+      return requested;
+   }
+   return std::max(1U, std::thread::hardware_concurrency());
+}
+
+
+// Calls fn(task) for every task in [0, tasksCount) on up to `threadsCount` threads, calling thread included.
+// Every thread takes contiguous range of tasks
+template <class Fn>
+void For(size_t tasksCount, size_t threadsCount, const Fn& fn)
+{
+   threadsCount = std::min(threadsCount, tasksCount);
+   auto runRange = [tasksCount, threadsCount, &fn] (size_t thread) {
+      size_t end = tasksCount * (thread + 1) / threadsCount;
+      for (size_t task = tasksCount * thread / threadsCount; task < end; ++task) {
+         fn(task);
+      }
+   };
+
+   std::vector<std::thread> threads;
+   for (size_t thread = 1; thread < threadsCount; ++thread) {
+      threads.emplace_back(runRange, thread);
+   }
+   if (threadsCount != 0) {
+      runRange(0);
+   }
+   for (auto& thread : threads) {
+      thread.join();
+   }
+}
+
+
+// Stable sort of chunks on separate threads followed by pairwise merges, each level of merges in parallel
+template <class It, class Less>
+void StableSort(It first, It last, const Less& less, size_t threadsCount)
+{
+   const size_t minChunkSize = 16 * 1024;
+   const size_t count = last - first;
+   const size_t chunks = std::max<size_t>(1, std::min(threadsCount, count / minChunkSize));
+
+   std::vector<size_t> bounds(chunks + 1);
+   for (size_t i = 0; i <= chunks; ++i) {
+      bounds[i] = count * i / chunks;
+   }
+
+   For(chunks, threadsCount, [&] (size_t chunk) {
+      std::stable_sort(first + bounds[chunk], first + bounds[chunk + 1], less);
+   });
+   for (size_t width = 1; width < chunks; width *= 2) {
+      For((chunks + 2 * width - 1) / (2 * width), threadsCount, [&] (size_t merge) {
+         size_t low = 2 * width * merge;
+         size_t middle = std::min(low + width, chunks);
+         size_t high = std::min(low + 2 * width, chunks);
+         std::inplace_merge(first + bounds[low], first + bounds[middle], first + bounds[high], less);
+      });
+   }
+}
+
+} // namespace Parallel
+
+
+#endif // _PARALLEL_H_
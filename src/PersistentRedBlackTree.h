@@ -16,18 +16,82 @@ enum class RedBlackTreeNodeColor : unsigned char {
 };
 
 
+// Default node layout - color, entry and both childs stored as is.
+// Node makers may provide own layout, tree accesses node data only via color()/entry()/left()/right()
+template <typename EntryPtr, typename NodePtr>
+struct RedBlackTreeNodeLinks {
+   using Color = RedBlackTreeNodeColor;
+
+   RedBlackTreeNodeLinks() = default;
+
+   RedBlackTreeNodeLinks(Color color, const EntryPtr& entry, const NodePtr& left, const NodePtr& right)
+   {
+      link(color, entry, left, right);
+   }
+
+   void link(Color color, const EntryPtr& entry, const NodePtr& left, const NodePtr& right)
+   {
+      nodeColor = color;
+      nodeEntry = entry;
+      leftChild = left;
+      rightChild = right;
+   }
+
+   Color color() const
+   {
+      return nodeColor;
+   }
+
+   const EntryPtr& entry() const
+   {
+      return nodeEntry;
+   }
+
+   const NodePtr& left() const
+   {
+      return leftChild;
+   }
+
+   const NodePtr& right() const
+   {
+      return rightChild;
+   }
+
+private:
+   Color    nodeColor = Color::BLACK;
+   EntryPtr nodeEntry; // need to store key-value data by pointer to not copy them on node unsharing
+   NodePtr  leftChild;
+   NodePtr  rightChild;
+};
+
+
 template <typename Node>
 struct RedBlackTreeNodeMakerSharedPtr {
    using NodePtr = std::shared_ptr<const Node>;
 
+   template <typename Entry>
+   using EntryPtr = std::shared_ptr<const Entry>;
+
+   template <typename EntryPtr>
+   using NodeLinks = RedBlackTreeNodeLinks<EntryPtr, NodePtr>;
+
    template <typename EntryPtr>
    using NodeMakerFn = std::function<NodePtr(RedBlackTreeNodeColor color, const EntryPtr& entry, const NodePtr& left, const NodePtr& right)>;
 
+   template <typename Entry>
+   using EntryMakerFn = std::function<EntryPtr<Entry>(Entry&& entry)>;
+
    template <typename EntryPtr>
    static NodePtr make(RedBlackTreeNodeColor color, const EntryPtr& entry, const NodePtr& left, const NodePtr& right)
    {
       return std::make_shared<const Node>(color, entry, left, right);
    }
+
+   template <typename Entry>
+   static EntryPtr<Entry> makeEntry(Entry&& entry)
+   {
+      return std::make_shared<const Entry>(std::move(entry));
+   }
 };
 
 
@@ -45,53 +109,44 @@ public:
    using NodePtr = typename NodeMaker::NodePtr;
 
    using Entry = std::pair<key_type, mapped_type>;
-   using EntryPtr = std::shared_ptr<const Entry>;
+   using EntryPtr = typename NodeMaker::template EntryPtr<Entry>;
 
    using NodeMakerFn = typename NodeMaker::template NodeMakerFn<EntryPtr>;
+   using EntryMakerFn = typename NodeMaker::template EntryMakerFn<Entry>;
 
-private:
-   struct Node {
-      using Color = RedBlackTreeNodeColor;
-
-      Color    color;
-      EntryPtr entry; // need to store key-value data by pointer to not copy them on node unsharing
-      NodePtr  left;
-      NodePtr  right;
+   using NodeLinks = typename NodeMaker::template NodeLinks<EntryPtr>;
 
-      Node() = default;
+   struct Node : NodeLinks {
+      using Color = RedBlackTreeNodeColor;
 
-      Node(Color color, const EntryPtr& entry, const NodePtr& left, const NodePtr& right)
-         : color(color)
-         , entry(entry)
-         , left(left)
-         , right(right)
-      {}
+      using NodeLinks::NodeLinks;
 
       const key_type& key() const
       {
-         return entry->first;
+         return this->entry()->first;
       }
 
       const mapped_type& value() const
       {
-         return entry->second;
+         return this->entry()->second;
       }
 
       bool isRed() const
       {
-         return color == Color::RED;
+         return this->color() == Color::RED;
       }
 
       bool isBlack() const
       {
-         return color == Color::BLACK;
+         return this->color() == Color::BLACK;
       }
    };
 
 public:
-   PersistentRedBlackTree(NodeMakerFn maker = NodeMaker::template make<EntryPtr>, LessPred pred = LessPred())
-      : nodeMakerFn(maker)
-      , lessPred(pred)
+   PersistentRedBlackTree(NodeMakerFn maker = NodeMaker::template make<EntryPtr>, EntryMakerFn entryMaker = NodeMaker::template makeEntry<Entry>, LessPred pred = LessPred())
+      : lessPred(pred)
+      , nodeMakerFn(maker)
+      , entryMakerFn(entryMaker)
    {}
    PersistentRedBlackTree(const PersistentRedBlackTree& other) = default;
    PersistentRedBlackTree(PersistentRedBlackTree&& other) = default;
@@ -110,6 +165,16 @@ public:
    template <typename K>
    std::optional<Entry> get(const K& key, const lookup_move_cb& lookupCallback = lookup_move_cb()) const;
 
+   // visits all entries in tree order
+   template <typename Fn>
+   void forEach(Fn&& fn) const;
+
+   // Reports changes from this tree to `other`: entries only in other, only in this one and entries
+   // with same key but other value. Subtrees shared by both trees are skipped, so for trees derived
+   // from each other it costs O(changes * log n) instead of O(n)
+   template <typename OnAdded, typename OnRemoved, typename OnChanged>
+   void diff(const PersistentRedBlackTree& other, OnAdded&& onAdded, OnRemoved&& onRemoved, OnChanged&& onChanged) const;
+
    std::map<key_type, mapped_type> toMap() const;
 
    size_t getSize() const
@@ -117,6 +182,17 @@ public:
       return size;
    }
 
+   const NodePtr& getRoot() const
+   {
+      return root;
+   }
+
+   // makes tree with same makers and predicate, but other nodes
+   PersistentRedBlackTree withRoot(const NodePtr& newRoot, size_t newSize) const
+   {
+      return PersistentRedBlackTree(newRoot, newSize, nodeMakerFn, entryMakerFn, lessPred);
+   }
+
    void clear()
    {
       root.reset();
@@ -128,27 +204,28 @@ public:
    }
 
    template <typename K, typename V>
-   static EntryPtr makeEntry(K&& key, V&& value)
+   EntryPtr makeEntry(K&& key, V&& value) const
    {
-      return std::make_shared<const Entry>(std::forward<K>(key), std::forward<V>(value));
+      return entryMakerFn(Entry(std::forward<K>(key), std::forward<V>(value)));
    }
 
 private:
-   PersistentRedBlackTree(NodePtr root, std::size_t size, NodeMakerFn nodeMakerFn, LessPred lessPred)
+   PersistentRedBlackTree(NodePtr root, std::size_t size, NodeMakerFn nodeMakerFn, EntryMakerFn entryMakerFn, LessPred lessPred)
       : root(root)
       , size(size)
-      , nodeMakerFn(nodeMakerFn)
       , lessPred(lessPred)
+      , nodeMakerFn(nodeMakerFn)
+      , entryMakerFn(entryMakerFn)
    {}
 
    static bool isNodeRed(const NodePtr& node)
    {
-      return node && node->color == Node::Color::RED;
+      return node && node->isRed();
    }
 
    static bool isNodeBlack(const NodePtr& node)
    {
-      return node && node->color == Node::Color::BLACK;
+      return node && node->isBlack();
    }
 
    template <typename K, typename V>
@@ -190,34 +267,35 @@ private:
 
    NodePtr cloneNodeWithNewEntry(const NodePtr& node, const EntryPtr& new_entry) const
    {
-      return makeNode(node->color, new_entry, node->left, node->right);
+      return makeNode(node->color(), new_entry, node->left(), node->right());
    }
 
    NodePtr cloneNodeWithNewLeft(const NodePtr& node, const NodePtr& new_left) const
    {
-      return makeNode(node->color, node->entry, new_left, node->right);
+      return makeNode(node->color(), node->entry(), new_left, node->right());
    }
 
    NodePtr cloneNodeWithNewRight(const NodePtr& node, const NodePtr& new_right) const
    {
-      return makeNode(node->color, node->entry, node->left, new_right);
+      return makeNode(node->color(), node->entry(), node->left(), new_right);
    }
 
    NodePtr cloneNodeAsBlack(const NodePtr& node) const
    {
-      return makeNode(NodeColor::BLACK, node->entry, node->left, node->right);
+      return makeNode(NodeColor::BLACK, node->entry(), node->left(), node->right());
    }
 
    NodePtr cloneNodeAsRed(const NodePtr& node) const
    {
-      return makeNode(NodeColor::RED, node->entry, node->left, node->right);
+      return makeNode(NodeColor::RED, node->entry(), node->left(), node->right());
    }
 
 private:
-   NodePtr     root = nullptr;
-   size_t      size = 0;
-   LessPred    lessPred;
-   NodeMakerFn nodeMakerFn;
+   NodePtr      root = nullptr;
+   size_t       size = 0;
+   LessPred     lessPred;
+   NodeMakerFn  nodeMakerFn;
+   EntryMakerFn entryMakerFn;
 };
 
 
@@ -2,6 +2,7 @@
 
 #include "PersistentRedBlackTree.h"
 #include <stack>
+#include <vector>
 
 
 
@@ -13,7 +14,7 @@ PersistentRedBlackTree<Key, Val, Less, NodeMakerT> PersistentRedBlackTree<Key, V
    auto   new_root = cloneNodeAsBlack(mb_new_root);
    size_t new_size = size + (is_new_key ? 1 : 0);
 
-   return PersistentRedBlackTree(new_root, new_size, nodeMakerFn, lessPred);
+   return PersistentRedBlackTree(new_root, new_size, nodeMakerFn, entryMakerFn, lessPred);
 }
 
 
@@ -27,7 +28,7 @@ PersistentRedBlackTree<Key, Val, Less, NodeMakerT> PersistentRedBlackTree<Key, V
    }
 
    auto new_root = mb_new_root ? cloneNodeAsBlack(mb_new_root) : mb_new_root;
-   return PersistentRedBlackTree(new_root, size - 1, nodeMakerFn, lessPred);
+   return PersistentRedBlackTree(new_root, size - 1, nodeMakerFn, entryMakerFn, lessPred);
 }
 
 
@@ -40,16 +41,16 @@ auto PersistentRedBlackTree<Key, Val, Less, NodeMakerT>::get (const K& key, cons
       const key_type& cur_key = cur->key();
       if (lessPred(key, cur_key)) {
          if (lookupCallback) {
-            lookupCallback(*cur->entry, true);
+            lookupCallback(*cur->entry(), true);
          }
-         cur = cur->left;
+         cur = cur->left();
       } else if (lessPred(cur_key, key)) {
          if (lookupCallback) {
-            lookupCallback(*cur->entry, false);
+            lookupCallback(*cur->entry(), false);
          }
-         cur = cur->right;
+         cur = cur->right();
       } else {
-         return *cur->entry;
+         return *cur->entry();
       }
    }
    return std::nullopt;
@@ -64,54 +65,54 @@ auto PersistentRedBlackTree<Key, Val, Less, NodeMakerT>::balance(const NodePtr&
    // match: (color_l, color_l_l, color_l_r, color_r, color_r_l, color_r_r)
 
    // case (Some(R), _, _, Some(R), _, _) - both childs are red
-   if (isNodeRed(node->left) && isNodeRed(node->right)) {
-      auto new_left = node->left ? cloneNodeAsBlack(node->left) : node->left;
-      auto new_right = node->right ? cloneNodeAsBlack(node->right) : node->right;
+   if (isNodeRed(node->left()) && isNodeRed(node->right())) {
+      auto new_left = node->left() ? cloneNodeAsBlack(node->left()) : node->left();
+      auto new_right = node->right() ? cloneNodeAsBlack(node->right()) : node->right();
 
-      return makeNodeRed(node->entry, new_left, new_right);
+      return makeNodeRed(node->entry(), new_left, new_right);
    }
 
    // case (Some(R), _, _, Opt(B), _, _) - only left child is red
-   if (isNodeRed(node->left)) {
-      const NodePtr& l_l = node->left->left;
-      const NodePtr& l_r = node->left->right;
+   if (isNodeRed(node->left())) {
+      const NodePtr& l_l = node->left()->left();
+      const NodePtr& l_r = node->left()->right();
 
       // case: (Some(R), Some(R), _, ...)
       if (isNodeRed(l_l)) {
-         auto new_left = makeNodeBlack(l_l->entry, l_l->left, l_l->right);
-         auto new_right = makeNodeBlack(node->entry, l_r, node->right);
+         auto new_left = makeNodeBlack(l_l->entry(), l_l->left(), l_l->right());
+         auto new_right = makeNodeBlack(node->entry(), l_r, node->right());
 
-         return makeNodeRed(node->left->entry, new_left, new_right);
+         return makeNodeRed(node->left()->entry(), new_left, new_right);
       }
 
       // case: (Some(R), _, Some(R), ...)
       if (isNodeRed(l_r)) {
-         auto new_left = makeNodeBlack(node->left->entry, l_l, l_r->left);
-         auto new_right = makeNodeBlack(node->entry, l_r->right, node->right);
+         auto new_left = makeNodeBlack(node->left()->entry(), l_l, l_r->left());
+         auto new_right = makeNodeBlack(node->entry(), l_r->right(), node->right());
 
-         return makeNodeRed(l_r->entry, new_left, new_right);
+         return makeNodeRed(l_r->entry(), new_left, new_right);
       }
    }
 
    // case (Opt(B), _, _, Some(R), _, _) - only right child is red
-   if (isNodeRed(node->right)) {
-      const NodePtr& r_l = node->right->left;
-      const NodePtr& r_r = node->right->right;
+   if (isNodeRed(node->right())) {
+      const NodePtr& r_l = node->right()->left();
+      const NodePtr& r_r = node->right()->right();
 
       // case: (..., Some(R), Some(R), _)
       if (isNodeRed(r_l)) {
-         auto new_left = makeNodeBlack(node->entry, node->left, r_l->left);
-         auto new_right = makeNodeBlack(node->right->entry, r_l->right, r_r);
+         auto new_left = makeNodeBlack(node->entry(), node->left(), r_l->left());
+         auto new_right = makeNodeBlack(node->right()->entry(), r_l->right(), r_r);
 
-         return makeNodeRed(r_l->entry, new_left, new_right);
+         return makeNodeRed(r_l->entry(), new_left, new_right);
       }
 
       // case: (..., Some(R), _, Some(R))
       if (isNodeRed(r_r)) {
-         auto new_left = makeNodeBlack(node->entry, node->left, r_l);
-         auto new_right = makeNodeBlack(r_r->entry, r_r->left, r_r->right);
+         auto new_left = makeNodeBlack(node->entry(), node->left(), r_l);
+         auto new_right = makeNodeBlack(r_r->entry(), r_r->left(), r_r->right());
 
-         return makeNodeRed(node->right->entry, new_left, new_right);
+         return makeNodeRed(node->right()->entry(), new_left, new_right);
       }
    }
 
@@ -148,7 +149,7 @@ template <typename Key, typename Val, typename Less, template <typename> class N
 template <typename K, typename V>
 auto PersistentRedBlackTree<Key, Val, Less, NodeMakerT>::insertLeft(const NodePtr& node, K&& key, V&& value) const -> std::pair<NodePtr, bool>
 {
-   auto[new_left, is_new_key] = insert(node->left, std::forward<K>(key), std::forward<V>(value));
+   auto[new_left, is_new_key] = insert(node->left(), std::forward<K>(key), std::forward<V>(value));
    NodePtr new_node = cloneNodeWithNewLeft(node, new_left);
 
    if (is_new_key && new_node->isBlack()) {
@@ -164,7 +165,7 @@ template <typename Key, typename Val, typename Less, template <typename> class N
 template <typename K, typename V>
 auto PersistentRedBlackTree<Key, Val, Less, NodeMakerT>::insertRight(const NodePtr& node, K&& key, V&& value) const -> std::pair<NodePtr, bool>
 {
-   auto[new_right, is_new_key] = insert(node->right, std::forward<K>(key), std::forward<V>(value));
+   auto[new_right, is_new_key] = insert(node->right(), std::forward<K>(key), std::forward<V>(value));
    NodePtr new_node = cloneNodeWithNewRight(node, new_right);
 
    if (is_new_key && new_node->isBlack()) {
@@ -192,48 +193,48 @@ auto PersistentRedBlackTree<Key, Val, Less, NodeMakerT>::fuse(const NodePtr& lef
    // case: (Some(l), Some(r))
 
    // match: (left.color, right.color)
-   bool is_left_red = left->color == Node::Color::RED;
-   bool is_right_red = right->color == Node::Color::RED;
+   bool is_left_red = left->isRed();
+   bool is_right_red = right->isRed();
 
    // case: (B, R)
    if (!is_left_red && is_right_red) {
-      auto new_left = fuse(left, right->left);
-      return makeNodeRed(right->entry, new_left, right->right);
+      auto new_left = fuse(left, right->left());
+      return makeNodeRed(right->entry(), new_left, right->right());
    }
 
    // case: (R, B)
    if (is_left_red && !is_right_red) {
-      auto new_right = fuse(left->right, right);
-      return makeNodeRed(left->entry, left->left, new_right);
+      auto new_right = fuse(left->right(), right);
+      return makeNodeRed(left->entry(), left->left(), new_right);
    }
 
    // case: (R, R)
    if (is_left_red && is_right_red) {
-      auto fused = fuse(left->right, right->left);
+      auto fused = fuse(left->right(), right->left());
       if (isNodeRed(fused)) {
-         auto new_left = makeNodeRed(left->entry, left->left, fused->left);
-         auto new_right = makeNodeRed(right->entry, fused->right, right->right);
+         auto new_left = makeNodeRed(left->entry(), left->left(), fused->left());
+         auto new_right = makeNodeRed(right->entry(), fused->right(), right->right());
 
-         return makeNodeRed(fused->entry, new_left, new_right);
+         return makeNodeRed(fused->entry(), new_left, new_right);
       }
 
-      auto new_right = makeNodeRed(right->entry, fused, right->right);
+      auto new_right = makeNodeRed(right->entry(), fused, right->right());
 
-      return makeNodeRed(left->entry, left->left, new_right);
+      return makeNodeRed(left->entry(), left->left(), new_right);
    }
 
    // case: (B, B)
-   auto fused = fuse(left->right, right->left);
+   auto fused = fuse(left->right(), right->left());
    if (isNodeRed(fused)) {
-      auto new_left = makeNodeBlack(left->entry, left->left, fused->left);
-      auto new_right = makeNodeBlack(right->entry, fused->right, right->right);
+      auto new_left = makeNodeBlack(left->entry(), left->left(), fused->left());
+      auto new_right = makeNodeBlack(right->entry(), fused->right(), right->right());
 
-      return makeNodeRed(fused->entry, new_left, new_right);
+      return makeNodeRed(fused->entry(), new_left, new_right);
    }
 
-   auto new_right = makeNodeBlack(right->entry, fused, right->right);
+   auto new_right = makeNodeBlack(right->entry(), fused, right->right());
 
-   auto new_node = makeNodeRed(left->entry, left->left, new_right);
+   auto new_node = makeNodeRed(left->entry(), left->left(), new_right);
    return balanceRemoveLeft(new_node);
 }
 
@@ -243,30 +244,30 @@ auto PersistentRedBlackTree<Key, Val, Less, NodeMakerT>::balanceRemoveLeft(const
 {
    // match: (color_l, color_r, color_r_l)
    // case: (Some(R), ..)
-   if (isNodeRed(node->left)) {
-      auto new_left = makeNodeBlack(node->left->entry, node->left->left, node->left->right);
+   if (isNodeRed(node->left())) {
+      auto new_left = makeNodeBlack(node->left()->entry(), node->left()->left(), node->left()->right());
 
-      return makeNodeRed(node->entry, new_left, node->right);
+      return makeNodeRed(node->entry(), new_left, node->right());
    }
 
    // case: (_, Some(B), _)
-   if (isNodeBlack(node->right)) {
-      auto new_right = makeNodeRed(node->right->entry, node->right->left, node->right->right);
+   if (isNodeBlack(node->right())) {
+      auto new_right = makeNodeRed(node->right()->entry(), node->right()->left(), node->right()->right());
 
-      auto new_node = makeNodeBlack(node->entry, node->left, new_right);
+      auto new_node = makeNodeBlack(node->entry(), node->left(), new_right);
       return balance(new_node);
 
    }
 
    // case: (_, Some(R), Some(B))
-   assert(isNodeRed(node->right) && isNodeBlack(node->right->left));
+   assert(isNodeRed(node->right()) && isNodeBlack(node->right()->left()));
 
-   auto unbalanced_new_right = makeNodeBlack(node->right->entry, node->right->left->right, cloneNodeAsRed(node->right->right));
+   auto unbalanced_new_right = makeNodeBlack(node->right()->entry(), node->right()->left()->right(), cloneNodeAsRed(node->right()->right()));
    auto new_right = balance(unbalanced_new_right);
 
-   auto new_left = makeNodeBlack(node->entry, node->left, node->right->left->left);
+   auto new_left = makeNodeBlack(node->entry(), node->left(), node->right()->left()->left());
 
-   return makeNodeRed(node->right->left->entry, new_left, new_right);
+   return makeNodeRed(node->right()->left()->entry(), new_left, new_right);
 }
 
 
@@ -275,30 +276,30 @@ auto PersistentRedBlackTree<Key, Val, Less, NodeMakerT>::balanceRemoveRight(cons
 {
    // match: (color_l, color_l_r, color_r)
    // case: (.., Some(R))
-   if (isNodeRed(node->right)) {
-      auto new_right = makeNodeBlack(node->right->entry, node->right->left, node->right->right);
+   if (isNodeRed(node->right())) {
+      auto new_right = makeNodeBlack(node->right()->entry(), node->right()->left(), node->right()->right());
 
-      return makeNodeRed(node->entry, node->left, new_right);
+      return makeNodeRed(node->entry(), node->left(), new_right);
    }
 
    // case: (Some(B), ..)
-   if (isNodeBlack(node->left)) {
-      auto new_left = makeNodeRed(node->left->entry, node->left->left, node->left->right);
+   if (isNodeBlack(node->left())) {
+      auto new_left = makeNodeRed(node->left()->entry(), node->left()->left(), node->left()->right());
 
-      auto unbalanced_new_node = makeNodeBlack(node->entry, new_left, node->right);
+      auto unbalanced_new_node = makeNodeBlack(node->entry(), new_left, node->right());
       return balance(unbalanced_new_node);
 
    }
 
    // case: (Some(R), Some(B), _)
-   assert(isNodeRed(node->left) && isNodeBlack(node->left->right));
+   assert(isNodeRed(node->left()) && isNodeBlack(node->left()->right()));
 
-   auto unbalanced_new_left = makeNodeBlack(node->left->entry, cloneNodeAsRed(node->left->left), node->left->right->left);
+   auto unbalanced_new_left = makeNodeBlack(node->left()->entry(), cloneNodeAsRed(node->left()->left()), node->left()->right()->left());
    auto new_left = balance(unbalanced_new_left);
 
-   auto new_right = makeNodeBlack(node->entry, node->left->right->right, node->right);
+   auto new_right = makeNodeBlack(node->entry(), node->left()->right()->right(), node->right());
 
-   return makeNodeRed(node->left->right->entry, new_left, new_right);
+   return makeNodeRed(node->left()->right()->entry(), new_left, new_right);
 
 }
 
@@ -309,14 +310,14 @@ auto PersistentRedBlackTree<Key, Val, Less, NodeMakerT>::remove(const NodePtr& n
 {
    if (node) {
       const key_type& node_key = node->key();
-      if (key < node_key) {
+      if (lessPred(key, node_key)) {
          return removeLeft(node, key);
       }
-      if (node_key < key) {
+      if (lessPred(node_key, key)) {
          return removeRight(node, key);
       }
       // key == node->key
-      auto new_node = fuse(node->left, node->right);
+      auto new_node = fuse(node->left(), node->right());
       return std::make_pair(new_node, true);
    }
 
@@ -328,16 +329,16 @@ template <typename Key, typename Val, typename Less, template <typename> class N
 template <typename K>
 auto PersistentRedBlackTree<Key, Val, Less, NodeMakerT>::removeLeft(const NodePtr& node, const K& key) const -> std::pair<NodePtr, bool>
 {
-   auto[new_left, removed] = remove(node->left, key);
+   auto[new_left, removed] = remove(node->left(), key);
 
    if (!removed) {
-      // node->left must be equal to new_left
-      assert(new_left == node->left);
+      // node->left() must be equal to new_left
+      assert(new_left == node->left());
       return std::make_pair(node, false);
    }
 
-   auto new_node = makeNodeRed(node->entry, new_left, node->right);
-   if (isNodeBlack(node->left)) {
+   auto new_node = makeNodeRed(node->entry(), new_left, node->right());
+   if (isNodeBlack(node->left())) {
       auto balanced_new_node = balanceRemoveLeft(new_node);
       return std::make_pair(balanced_new_node, true);
    }
@@ -350,16 +351,16 @@ template <typename Key, typename Val, typename Less, template <typename> class N
 template <typename K>
 auto PersistentRedBlackTree<Key, Val, Less, NodeMakerT>::removeRight(const NodePtr& node, const K& key) const -> std::pair<NodePtr, bool>
 {
-   auto[new_right, removed] = remove(node->right, key);
+   auto[new_right, removed] = remove(node->right(), key);
 
    if (!removed) {
-      // node->right must be equal to new_left
-      assert(new_right == node->right);
+      // node->right() must be equal to new_left
+      assert(new_right == node->right());
       return std::make_pair(node, false);
    }
 
-   auto new_node = makeNodeRed(node->entry, node->left, new_right);
-   if (isNodeBlack(node->right)) {
+   auto new_node = makeNodeRed(node->entry(), node->left(), new_right);
+   if (isNodeBlack(node->right())) {
       auto balanced_new_node = balanceRemoveRight(new_node);
       return std::make_pair(balanced_new_node, true);
    }
@@ -376,8 +377,8 @@ size_t PersistentRedBlackTree<Key, Val, Less, NodeMakerT>::getBlackHeight(const
       return 1;
    }
 
-   const auto& left = node->left;
-   const auto& right = node->right;
+   const auto& left = node->left();
+   const auto& right = node->right();
 
    if (isNodeRed(node) && (isNodeRed(left) || isNodeRed(right))) {
       // invalid node:
@@ -415,22 +416,112 @@ size_t PersistentRedBlackTree<Key, Val, Less, NodeMakerT>::getBlackHeight(const
 
 
 template <typename Key, typename Val, typename Less, template <typename> class NodeMakerT>
-auto PersistentRedBlackTree<Key, Val, Less, NodeMakerT>::toMap () const -> std::map<key_type, mapped_type>
+template <typename Fn>
+void PersistentRedBlackTree<Key, Val, Less, NodeMakerT>::forEach (Fn&& fn) const
 {
-   std::map<key_type, mapped_type> out;
-   auto                            node = root;
-   auto                            s = std::stack<NodePtr>();
+   auto node = root;
+   auto s = std::stack<NodePtr>();
    while (!s.empty() || node) {
       if (node) {
          s.push(node);
-         node = node->left;
+         node = node->left();
       } else {
          node = s.top();
          s.pop();
-         out.emplace(node->entry->first, node->entry->second);
-         node = node->right;
+         fn(*node->entry());
+         node = node->right();
+      }
+   }
+}
+
+
+template <typename Key, typename Val, typename Less, template <typename> class NodeMakerT>
+template <typename OnAdded, typename OnRemoved, typename OnChanged>
+void PersistentRedBlackTree<Key, Val, Less, NodeMakerT>::diff (const PersistentRedBlackTree& other, OnAdded&& onAdded, OnRemoved&& onRemoved, OnChanged&& onChanged) const
+{
+   // fronts of in-order traversals of both trees - subtrees not expanded yet and single entries,
+   // next in order on top
+   struct Item {
+      NodePtr node;
+      bool    subtree;
+   };
+   auto push = [] (std::vector<Item>& front, const NodePtr& node) {
+      if (node) {
+         front.push_back(Item{ node, true });
+      }
+   };
+   auto expand = [&push] (std::vector<Item>& front) {
+      NodePtr node = front.back().node;
+      front.pop_back();
+      push(front, node->right());
+      front.push_back(Item{ node, false });
+      push(front, node->left());
+   };
+
+   std::vector<Item> from;
+   std::vector<Item> to;
+   push(from, root);
+   push(to, other.root);
+
+   while (!from.empty() && !to.empty()) {
+      const Item fromItem = from.back();
+      const Item toItem = to.back();
+      if (fromItem.node == toItem.node && fromItem.subtree == toItem.subtree) {
+         // shared subtree or node - nothing changed inside
+         from.pop_back();
+         to.pop_back();
+      } else if (fromItem.subtree && toItem.subtree) {
+         // expand subtree with greater root, it may contain other one as its leftmost part
+         if (lessPred(toItem.node->key(), fromItem.node->key())) {
+            expand(from);
+         } else {
+            expand(to);
+         }
+      } else if (fromItem.subtree) {
+         expand(from);
+      } else if (toItem.subtree) {
+         expand(to);
+      } else if (lessPred(fromItem.node->key(), toItem.node->key())) {
+         onRemoved(*fromItem.node->entry());
+         from.pop_back();
+      } else if (lessPred(toItem.node->key(), fromItem.node->key())) {
+         onAdded(*toItem.node->entry());
+         to.pop_back();
+      } else {
+         if (fromItem.node->entry() != toItem.node->entry() && !(fromItem.node->value() == toItem.node->value())) {
+            onChanged(*fromItem.node->entry(), *toItem.node->entry());
+         }
+         from.pop_back();
+         to.pop_back();
+      }
+   }
+
+   while (!from.empty()) {
+      if (from.back().subtree) {
+         expand(from);
+      } else {
+         onRemoved(*from.back().node->entry());
+         from.pop_back();
+      }
+   }
+   while (!to.empty()) {
+      if (to.back().subtree) {
+         expand(to);
+      } else {
+         onAdded(*to.back().node->entry());
+         to.pop_back();
       }
    }
+}
+
+
+template <typename Key, typename Val, typename Less, template <typename> class NodeMakerT>
+auto PersistentRedBlackTree<Key, Val, Less, NodeMakerT>::toMap () const -> std::map<key_type, mapped_type>
+{
+   std::map<key_type, mapped_type> out;
+   forEach([&out] (const Entry& entry) {
+      out.emplace(entry.first, entry.second);
+   });
    assert(out.size() == getSize());
    return out;
 }
\ No newline at end of file
@@ -1,321 +1,1700 @@
 #include "PlayerRankingDB.h"
 
-#include <windows.h>
-
-#ifdef max
-#undef max
-#endif 
-
+#include <atomic>
+#include <charconv>
+#include <functional>
+#include <ostream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <algorithm>
 
 
+#include "BumpAllocator.h"
+#include "CsvFormat.h"
+#include "EpochReclaimer.h"
+#include "LeaderboardFormat.h"
+#include "Parallel.h"
 #include "PersistentRedBlackTree.h"
+#include "RedBlackTreeCompactNode.h"
+#include "SnapshotFormat.h"
+#include "Varint.h"
 
 
-template <class T>
-class BumpAllocator {
-public:
-   BumpAllocator(size_t reserved, size_t pageSize);
-   ~BumpAllocator();
-
-   T* Allocate();
-   void ReleaseUpTo(T* ptr) { current = ptr; }
+using VirtualMemory::MB;
 
-   T* GetCurrent() const { return current; }
 
-private:
-   T* current;
-   unsigned char* physicalEnd;
-   unsigned char* virtualStart;
-   unsigned char* virtualEnd;
-   size_t growSize;
-};
+// Copying collection of nodes and entries reachable from given roots into fresh arenas.
+// Nodes outside of old arenas (shared with DB this one was forked from) are copied as well
+template <class TreeT>
+class ArenaCompactor {
+public:
+   using Node = typename TreeT::Node;
+   using NodePtr = typename TreeT::NodePtr;
+   using Entry = typename TreeT::Entry;
+   using EntryPtr = typename TreeT::EntryPtr;
+
+   // entries data may be moved out only if old arenas are dropped right after and nobody else shares them.
+   // remapEntry redirects references of copied entry to copies made by other compactor
+   ArenaCompactor(const BumpAllocator<Node>& oldNodeAlloc, const BumpAllocator<Entry>& oldEntryAlloc, BumpAllocator<Node>& newNodeAlloc, BumpAllocator<Entry>& newEntryAlloc, bool moveEntries, std::function<void(Entry&)> remapEntry = nullptr)
+      : oldNodes(oldNodeAlloc.GetStart())
+      , oldEntries(oldEntryAlloc.GetStart())
+      , newNodeAlloc(newNodeAlloc)
+      , newEntryAlloc(newEntryAlloc)
+      , moveEntries(moveEntries)
+      , remapEntry(std::move(remapEntry))
+      , forwardNodes(oldNodeAlloc.GetCount(), nullptr)
+      , forwardEntries(oldEntryAlloc.GetCount(), nullptr)
+   {}
+
+   NodePtr Copy(const NodePtr& node)
+   {
+      if (!node) {
+         return nullptr;
+      }
+      NodePtr& forward = ForwardOf(node, oldNodes, forwardNodes, foreignNodes);
+      if (!forward) {
+         // childs first - every version references only nodes copied before its own root
+         NodePtr left = Copy(node->left());
+         NodePtr right = Copy(node->right());
+         Node* newNode = newNodeAlloc.Allocate();
+         newNode->link(node->color(), CopyEntry(node->entry()), left, right);
+         forward = newNode;
+      }
+      return forward;
+   }
 
+   // copy of entry, which must be reachable from nodes copied before
+   EntryPtr Forward(const EntryPtr& entry)
+   {
+      EntryPtr forward = ForwardOf(entry, oldEntries, forwardEntries, foreignEntries);
+      assert(forward);
+      return forward;
+   }
 
-const size_t KB = 1 << 10;
-const size_t MB = KB << 10;
-const size_t GB = MB << 10;
-const size_t TB = GB << 10;
+private:
+   EntryPtr CopyEntry(const EntryPtr& entry)
+   {
+      bool owned = false;
+      EntryPtr& forward = ForwardOf(entry, oldEntries, forwardEntries, foreignEntries, &owned);
+      if (!forward) {
+         Entry* newEntry = newEntryAlloc.Allocate();
+         if (owned && moveEntries) {
+            // each entry is copied once and old arena is dropped after compaction - safe to steal its data
+            *newEntry = std::move(const_cast<Entry&>(*entry));
+         } else {
+            *newEntry = *entry;
+         }
+         if (remapEntry) {
+            remapEntry(*newEntry);
+         }
+         forward = newEntry;
+      }
+      return forward;
+   }
 
+   template <class T>
+   static const T*& ForwardOf(const T* ptr, const T* oldStart, std::vector<const T*>& forward, std::unordered_map<const T*, const T*>& foreign, bool* owned = nullptr)
+   {
+      size_t offset = (uintptr_t)ptr - (uintptr_t)oldStart;
+      if (offset < forward.size() * sizeof(T)) {
+         if (owned) {
+            *owned = true;
+         }
+         return forward[offset / sizeof(T)];
+      }
+      return foreign[ptr];
+   }
 
-template <class T>
-BumpAllocator<T>::BumpAllocator(size_t reserved, size_t growSize)
-   : growSize(growSize)
-{
-   const int PAGE_SIZE = 64 * KB;
-   assert(growSize % PAGE_SIZE == 0);
-   assert(reserved % growSize == 0);
-   // TODO: check alignment
+   const Node*  oldNodes;
+   const Entry* oldEntries;
 
-   virtualStart = (unsigned char*)VirtualAlloc(NULL, reserved, MEM_RESERVE, PAGE_READWRITE);
-   virtualEnd = virtualStart + reserved;
+   BumpAllocator<Node>&  newNodeAlloc;
+   BumpAllocator<Entry>& newEntryAlloc;
+   bool                  moveEntries;
 
-   physicalEnd = virtualStart;
-   current = (T*)physicalEnd;
-}
+   std::function<void(Entry&)> remapEntry;
 
+   std::vector<NodePtr>  forwardNodes;
+   std::vector<EntryPtr> forwardEntries;
 
-template <class T>
-BumpAllocator<T>::~BumpAllocator()
-{
-   // deconstruct all constructed objects
-   T* cur = (T*)virtualStart;
-   while ((unsigned char*)(cur + 1) < physicalEnd) {
-      cur->~T();
-      cur++;
-   }
+   std::unordered_map<NodePtr, NodePtr>   foreignNodes;
+   std::unordered_map<EntryPtr, EntryPtr> foreignEntries;
+};
 
-   VirtualFree(virtualStart, 0, MEM_RELEASE);
-}
 
+// Links nodes of sorted elements into balanced red-black tree. Node of i-th element is nodes[i] and every
+// subtree root is the middle of its range, so children are known without building them first and
+// disjoint subtrees are linked by separate threads.
+// Every root to nil path takes either fullLevels or fullLevels + 1 nodes, so nodes below full levels
+// are red and black height is the same on all paths
+template <class Node>
+class BalancedTreeLinker {
+public:
+   using NodePtr = const Node*;
 
-template <class T>
-T* BumpAllocator<T>::Allocate()
-{
-   if ((unsigned char*)(current + 1) > physicalEnd) {
-      // not enough physical memory - need to commit more pages
-      if (physicalEnd + growSize > virtualEnd) {
-         // not enough virtual memory - can't allocate more
-         return nullptr;
-      }
-      if (VirtualAlloc(physicalEnd, growSize, MEM_COMMIT, PAGE_READWRITE) == 0) {
-         // allocation failed some how
-         return nullptr;
-      }
-      physicalEnd += growSize;
-      // construct objects of T in just allocated memory
-      T* cur = current;
-      while ((unsigned char*)(cur + 1) < physicalEnd) {
-         new (cur) T();
-         cur++;
+   BalancedTreeLinker(Node* nodes, size_t count)
+      : nodes(nodes)
+      , count(count)
+   {
+      assert(count < (size_t)Node::maxLinkOffset);
+      while (((size_t)2 << fullLevels) - 1 <= count) {
+         ++fullLevels;
       }
    }
 
-   return current++;
-}
-
+   NodePtr GetRoot() const { return SubtreeRoot(0, count); }
 
+   // linkFn(node, index, low, high, color, left, right) links node of element `index`, whose subtree holds [low, high)
+   template <class LinkFn>
+   void Link(size_t threadsCount, const LinkFn& linkFn) const
+   {
+      // top levels on calling thread, enough subtrees below them to balance threads load
+      size_t parallelDepth = 0;
+      while (((size_t)1 << parallelDepth) < 4 * threadsCount && parallelDepth < fullLevels) {
+         ++parallelDepth;
+      }
+      std::vector<Range> subtrees;
+      LinkSubtree(Range{ 0, count, 0 }, linkFn, parallelDepth, &subtrees);
+      Parallel::For(subtrees.size(), threadsCount, [&] (size_t subtree) {
+         LinkSubtree(subtrees[subtree], linkFn, SIZE_MAX, nullptr);
+      });
+   }
 
-template <typename Node>
-struct NodeMakerRawPtr {
-   using NodePtr = const Node*;
+private:
+   struct Range {
+      size_t low;
+      size_t high;
+      size_t depth;
+   };
 
-   template <typename EntryPtr>
-   using NodeMakerFn = std::function<NodePtr(RedBlackTreeNodeColor color, const EntryPtr& entry, const NodePtr& left, const NodePtr& right)>;
+   NodePtr SubtreeRoot(size_t low, size_t high) const
+   {
+      return low < high ? nodes + low + (high - low) / 2 : nullptr;
+   }
 
-   template <typename EntryPtr>
-   static NodePtr make(RedBlackTreeNodeColor color, const EntryPtr& entry, const NodePtr& left, const NodePtr& right)
+   template <class LinkFn>
+   void LinkSubtree(const Range& range, const LinkFn& linkFn, size_t deferDepth, std::vector<Range>* deferred) const
    {
-      return nullptr;
+      if (range.low == range.high) {
+         return;
+      }
+      if (range.depth == deferDepth) {
+         deferred->push_back(range);
+         return;
+      }
+      size_t middle = range.low + (range.high - range.low) / 2;
+      auto color = range.depth < fullLevels ? RedBlackTreeNodeColor::BLACK : RedBlackTreeNodeColor::RED;
+      linkFn(nodes + middle, middle, range.low, range.high, color, SubtreeRoot(range.low, middle), SubtreeRoot(middle + 1, range.high));
+      LinkSubtree(Range{ range.low, middle, range.depth + 1 }, linkFn, deferDepth, deferred);
+      LinkSubtree(Range{ middle + 1, range.high, range.depth + 1 }, linkFn, deferDepth, deferred);
    }
+
+   Node*  nodes;
+   size_t count;
+   size_t fullLevels = 0;
 };
 
 
 struct PlayerRankingDB::Impl {
-   using PlayersRatingsTree = PersistentRedBlackTree<std::string, int, std::less<std::string>, NodeMakerRawPtr>;
+   using PlayersRatingsTree = PersistentRedBlackTree<std::string, int, std::less<std::string>, RedBlackTreeNodeMakerCompact>;
 
+   // Rankings tree holds a node per player in ranking order - ratings descending, equal ones by name.
+   // Name isn't copied, key references entry of player in ratings tree of the same version
+   struct RankingKey {
+      int                              rating;
+      const PlayersRatingsTree::Entry* player;
+   };
    struct RankingData {
-      int numEqualRating;
-      int leftSubtreeSize;
+      int leftSubtreeSize; // number of players in left subtree
+      int subtreeSize;     // number of players in whole subtree of node
+   };
+   struct RankingLess {
+      bool operator()(const RankingKey& left, const RankingKey& right) const
+      {
+         return left.rating != right.rating ? left.rating > right.rating : left.player->first < right.player->first;
+      }
    };
-   using PlayersRankingsTree = PersistentRedBlackTree<int, RankingData, std::greater<int>, NodeMakerRawPtr>;
+   using PlayersRankingsTree = PersistentRedBlackTree<RankingKey, RankingData, RankingLess, RedBlackTreeNodeMakerCompact>;
+
+   static_assert(sizeof(PlayersRatingsTree::Node) <= 16, "compact nodes must fit 4 per cache line");
+   static_assert(sizeof(PlayersRankingsTree::Node) <= 16, "compact nodes must fit 4 per cache line");
 
+   // Versions journal of one tree - structure of arrays, one element per version.
+   // Trees are not stored, older versions are restored on demand as views on their roots
    template <class TreeT>
-   struct Snapshot {
+   struct TreeJournal {
       using Node = typename TreeT::Node;
-      TreeT tree;
-      Node* nodeAllocTop = nullptr;
+      using Entry = typename TreeT::Entry;
+
+      std::vector<typename TreeT::NodePtr> roots;
+      std::vector<size_t>                  sizes;
+      std::vector<Node*>                   nodeAllocTops;
+      std::vector<Entry*>                  entryAllocTops;
+
+      void Push(const TreeT& tree, Node* nodeAllocTop, Entry* entryAllocTop)
+      {
+         roots.push_back(tree.getRoot());
+         sizes.push_back(tree.getSize());
+         nodeAllocTops.push_back(nodeAllocTop);
+         entryAllocTops.push_back(entryAllocTop);
+      }
+
+      void Truncate(size_t newSize)
+      {
+         roots.resize(newSize);
+         sizes.resize(newSize);
+         nodeAllocTops.resize(newSize);
+         entryAllocTops.resize(newSize);
+      }
+
+      void EraseFront(size_t count)
+      {
+         roots.erase(roots.begin(), roots.begin() + count);
+         sizes.erase(sizes.begin(), sizes.begin() + count);
+         nodeAllocTops.erase(nodeAllocTops.begin(), nodeAllocTops.begin() + count);
+         entryAllocTops.erase(entryAllocTops.begin(), entryAllocTops.begin() + count);
+      }
+
+      TreeT View(const TreeT& tree, size_t version) const
+      {
+         return tree.withRoot(roots[version], sizes[version]);
+      }
+
+      // view for lookups only - it has default makers, which can't allocate arena nodes
+      TreeT ReadOnlyView(size_t version) const
+      {
+         return TreeT().withRoot(roots[version], sizes[version]);
+      }
+   };
+
+   struct History {
+      std::vector<Version>             versions; // ascending ids of retained versions
+      TreeJournal<PlayersRatingsTree>  ratings;
+      TreeJournal<PlayersRankingsTree> rankings;
+      // names heap counters of Impl as they were at each version
+      std::vector<size_t>              namesHeapBytes;
+      std::vector<size_t>              liveNamesHeapBytes;
+
+      size_t Size() const { return versions.size(); }
+
+      void Truncate(size_t newSize)
+      {
+         versions.resize(newSize);
+         ratings.Truncate(newSize);
+         rankings.Truncate(newSize);
+         namesHeapBytes.resize(newSize);
+         liveNamesHeapBytes.resize(newSize);
+      }
+
+      void EraseFront(size_t count)
+      {
+         versions.erase(versions.begin(), versions.begin() + count);
+         ratings.EraseFront(count);
+         rankings.EraseFront(count);
+         namesHeapBytes.erase(namesHeapBytes.begin(), namesHeapBytes.begin() + count);
+         liveNamesHeapBytes.erase(liveNamesHeapBytes.begin(), liveNamesHeapBytes.begin() + count);
+      }
+
+      // index of version in history or Size() if it's not retained
+      size_t Find(Version version) const
+      {
+         auto it = std::lower_bound(versions.begin(), versions.end(), version);
+         return it != versions.end() && *it == version ? it - versions.begin() : Size();
+      }
+   };
+
+   // Arenas of both trees. They are shared with forks, which keep referencing nodes of version
+   // they were forked from - memory up to that version is pinned and never reused
+   struct Arenas {
+      BumpAllocator<PlayersRatingsTree::Node>   playersRatingsNodeAlloc;
+      BumpAllocator<PlayersRatingsTree::Entry>  playersRatingsEntryAlloc;
+      BumpAllocator<PlayersRankingsTree::Node>  rankingNodeAlloc;
+      BumpAllocator<PlayersRankingsTree::Entry> rankingEntryAlloc;
 
-      Snapshot() = default;
-      Snapshot(TreeT&& tree, Node* node) : tree(std::move(tree)), nodeAllocTop(node) {}
+      Arenas(const Options& options);
+
+      size_t GetUsedBytes() const;
    };
-   using PlayersRatingsSnapshot = Snapshot<PlayersRatingsTree>;
-   using PlayersRankingsSnapshot = Snapshot<PlayersRankingsTree>;
 
-   using PlayersRatingsHistory = std::vector<PlayersRatingsSnapshot>;
-   using PlayersRankingsHistory = std::vector<PlayersRankingsSnapshot>;
+   Options options;
+   size_t  compactedBytes = 0; // arenas usage right after last compaction
+
+   std::shared_ptr<Arenas>              arenas;
+   std::vector<std::shared_ptr<Arenas>> sharedArenas; // arenas of DBs this one was forked from, until next compaction
 
-   BumpAllocator<PlayersRatingsTree::Node> playersRatingsNodeAlloc;
-   PlayersRatingsHistory                   playersRatingsHistory;
+   PlayersRatingsTree  playersRatings;
+   PlayersRankingsTree rankings;
 
-   BumpAllocator<PlayersRankingsTree::Node> rankingNodeAlloc;
-   PlayersRankingsHistory                   rankingHistory;
+   // current version as seen by readers and snapshots. Without concurrentReads readers use the trees
+   // directly and record is made only when snapshot asks for it, until next write
+   std::atomic<const PublishedVersion*>    published{ nullptr };
+   std::shared_ptr<const PublishedVersion> publishedHolder;
+   // every published version which may still be held by snapshots, expired ones are pruned in batches
+   std::vector<std::weak_ptr<const PublishedVersion>> publishedVersions;
+   size_t                                             unprunedVersions = 0;
+   // defers release of memory readers may still observe, declared after arenas to be destroyed first
+   mutable EpochReclaimer                  reclaimer;
 
-   Impl();
+   History history;
+   size_t  currentVersion = 0; // index of current version in history, later ones are available for Redo
+   Version lastVersion = 0;    // last id given to a version, ids of discarded versions are never reused
+
+   // heap memory of names held by ratings entries below arena top and by ones reachable from current version.
+   // Counted as entries are made and players come and go, so memory stats don't walk arenas or trees
+   size_t namesHeapBytes = 0;
+   size_t liveNamesHeapBytes = 0;
+
+   std::unordered_map<std::string, Version> tags;
+
+   Impl(const Options& options);
 
    void RegisterPlayerResult(std::string&& playerName, int playerRating);
    void UnregisterPlayer(const std::string& playerName);
+   void ApplyBatch(std::vector<WriteCommand>&& commands);
+   bool ApplyCommands(std::vector<WriteCommand>&& commands);
+   bool BulkLoad(std::vector<std::pair<std::string, int>>&& players, size_t threadsCount);
+   bool LoadSnapshot(const std::string& path, size_t threadsCount);
+   bool ImportPlayers(const std::string& path, char separator, size_t threadsCount);
+   bool ApplyChanges(const std::string& path);
    void Rollback(int step);
+   void Redo(int step);
+   bool RollbackTo(Version version);
+   Version GetVersion() const { return history.versions[currentVersion]; }
+   Version GetRollbackVersion(int step) const;
+
+   static int GetPlayerRank(const PlayersRatingsTree& ratings, const PlayersRankingsTree& rankings, const std::string& playerName);
+   static std::vector<PlayerInfoRow> GetPlayersInfo(const PlayersRatingsTree& ratings, const PlayersRankingsTree& rankings, size_t threadsCount = 1);
+   static std::vector<PlayerInfoRow> GetPlayersPage(const PlayersRankingsTree& rankings, size_t offset, size_t count);
+   // calls fn(entry, ranking) for all players in ranking order, equal ratings ordered by name
+   template <class Fn>
+   static void ForEachRanked(const PlayersRankingsTree& rankings, const Fn& fn);
+   static int GetRatingRank(const PlayersRankingsTree& rankings, int rating);
+   static size_t CountRatingsAbove(const PlayersRankingsTree& rankings, int rating);
+   // entry of player in ratings tree, it's the same in later versions until player's rating changes
+   static const PlayersRatingsTree::Entry* FindPlayer(const PlayersRatingsTree& ratings, const std::string& playerName);
+   static size_t GetNamesHeapBytes(const PlayersRatingsTree::Entry* begin, const PlayersRatingsTree::Entry* end);
+   MemoryStats GetMemoryStats() const;
+
+   std::unique_ptr<Impl> Fork() const;
+   bool CanShareNodesOf(const Impl& other) const;
+
+   void PushVersion(Version version);
+   void RestoreVersion(size_t version);
+   void Publish();
+   void PublishCurrent();
+   std::shared_ptr<const PublishedVersion> GetPublished();
+   template <class Fn>
+   auto ReadCurrent(Fn&& fn) const;
+   EpochReclaimer::ReadGuard PinForRead() const;
+   bool IsPublishedAfter(Version version);
+   void DiscardRedo();
+   void DropOldestVersions(size_t count);
+   void TrimHistory();
+
+   // write steps, return false if nothing was changed. Changes become a version only on Commit
+   bool SetPlayerRating(std::string&& playerName, int playerRating);
+   bool RemovePlayer(const std::string& playerName);
+   void Commit();
+   // sorts players by name, the last of equal names wins
+   static void SortUnique(std::vector<std::pair<std::string, int>>& players, size_t threadsCount);
+   // replaces both trees, players are sorted by name without duplicates
+   bool LoadSorted(std::vector<std::pair<std::string, int>>&& players, size_t threadsCount);
+
+   void LimitHistory();
+   void CompactHistory(size_t firstRetained);
+   template <class TreeT>
+   static void CompactHistory(TreeJournal<TreeT>& journal, const TreeT& tree, size_t firstRetained, ArenaCompactor<TreeT>& compactor, const BumpAllocator<typename TreeT::Node>& newNodeAlloc, const BumpAllocator<typename TreeT::Entry>& newEntryAlloc);
+
+   const PlayersRatingsTree& GetCurrentRatings() const { return playersRatings; }
+   const PlayersRankingsTree& GetCurrentRankings() const { return rankings; }
+};
 
-   int GetPlayerRank(const std::string& playerName) const;
 
-   const PlayersRatingsTree& GetCurrentRatings() const { return playersRatingsHistory.back().tree; }
-   const PlayersRankingsTree& GetCurrentRankings() const { return rankingHistory.back().tree; }
+// Immutable version record shared by readers and snapshots. It references arenas its nodes live in,
+// so those outlive compaction and DB itself while record is held
+struct PlayerRankingDB::PublishedVersion : std::enable_shared_from_this<PublishedVersion> {
+   Version                  version = 0;
+   Impl::PlayersRatingsTree  ratings;  // read-only views with default makers
+   Impl::PlayersRankingsTree rankings;
+
+   std::shared_ptr<const Impl::Arenas>              arenas;
+   std::vector<std::shared_ptr<const Impl::Arenas>> sharedArenas;
 };
 
 
-PlayerRankingDB::Impl::Impl ()
-   : playersRatingsNodeAlloc(100 * MB, 1 * MB)
-   , rankingNodeAlloc(100 * MB, 1 * MB)
+// compact nodes link each other with 32-bit offsets, so node arena can't be larger than links reach
+template <class Node>
+static size_t GetNodeArenaReserveSize(size_t reserveSize)
+{
+   const uint64_t linkReach = (uint64_t)Node::maxLinkOffset * sizeof(Node);
+   return (uint64_t)reserveSize < linkReach ? reserveSize : (size_t)linkReach;
+}
+
+
+// heap memory of string not fitting into its inline buffer. Taken by length rather than capacity - compaction
+// copies names without spare capacity, which mustn't change stats of versions it didn't change
+static size_t GetStringHeapBytes(const std::string& str)
+{
+   static const size_t inlineCapacity = std::string().capacity();
+   return str.size() > inlineCapacity ? str.size() + 1 : 0;
+}
+
+
+PlayerRankingDB::Impl::Arenas::Arenas (const Options& options)
+   : playersRatingsNodeAlloc(GetNodeArenaReserveSize<PlayersRatingsTree::Node>(options.arenaReserveSize), 1 * MB, (VirtualMemoryPages)options.arenaPages, options.arenaDirectory)
+   , playersRatingsEntryAlloc(options.arenaReserveSize, 1 * MB, (VirtualMemoryPages)options.arenaPages, options.arenaDirectory)
+   , rankingNodeAlloc(GetNodeArenaReserveSize<PlayersRankingsTree::Node>(options.arenaReserveSize), 1 * MB, (VirtualMemoryPages)options.arenaPages, options.arenaDirectory)
+   , rankingEntryAlloc(options.arenaReserveSize, 1 * MB, (VirtualMemoryPages)options.arenaPages, options.arenaDirectory)
+{}
+
+
+size_t PlayerRankingDB::Impl::Arenas::GetUsedBytes() const
+{
+   return playersRatingsNodeAlloc.GetUsedSize() + playersRatingsEntryAlloc.GetUsedSize() + rankingNodeAlloc.GetUsedSize() + rankingEntryAlloc.GetUsedSize();
+}
+
+
+PlayerRankingDB::Impl::Impl (const Options& options)
+   : options(options)
+   , arenas(std::make_shared<Arenas>(options))
 {
    auto playerRatingNodeMakerFn = [&] (PlayersRatingsTree::NodeColor color, const PlayersRatingsTree::EntryPtr& entry, const PlayersRatingsTree::NodePtr& left, const PlayersRatingsTree::NodePtr& right) -> PlayersRatingsTree::NodePtr {
-      auto* node = playersRatingsNodeAlloc.Allocate();
-      node->color = color;
-      node->entry = entry;
-      node->left = left;
-      node->right = right;
+      auto* node = arenas->playersRatingsNodeAlloc.Allocate();
+      node->link(color, entry, left, right);
       return node;
    };
+   auto playerRatingEntryMakerFn = [&] (PlayersRatingsTree::Entry&& entry) -> PlayersRatingsTree::EntryPtr {
+      auto* newEntry = arenas->playersRatingsEntryAlloc.Allocate();
+      *newEntry = std::move(entry);
+      namesHeapBytes += GetStringHeapBytes(newEntry->first);
+      return newEntry;
+   };
+
+   playersRatings = PlayersRatingsTree{ playerRatingNodeMakerFn, playerRatingEntryMakerFn };
 
-   playersRatingsHistory.emplace_back(PlayersRatingsTree{ playerRatingNodeMakerFn }, playersRatingsNodeAlloc.GetCurrent());
+   auto rankingEntryMakerFn = [&] (PlayersRankingsTree::Entry&& entry) -> PlayersRankingsTree::EntryPtr {
+      auto* newEntry = arenas->rankingEntryAlloc.Allocate();
+      *newEntry = std::move(entry);
+      return newEntry;
+   };
 
-   auto rankingNodeMakerFn = [&] (PlayersRankingsTree::NodeColor color, const PlayersRankingsTree::EntryPtr& entry, const PlayersRankingsTree::NodePtr& left, const PlayersRankingsTree::NodePtr& right) -> PlayersRankingsTree::NodePtr {
-      int newLeftSubtreeSize = left ? (left->entry->second.leftSubtreeSize + left->entry->second.numEqualRating) : 0;
+   auto rankingNodeMakerFn = [&, rankingEntryMakerFn] (PlayersRankingsTree::NodeColor color, const PlayersRankingsTree::EntryPtr& entry, const PlayersRankingsTree::NodePtr& left, const PlayersRankingsTree::NodePtr& right) -> PlayersRankingsTree::NodePtr {
+      int newLeftSubtreeSize = left ? left->entry()->second.subtreeSize : 0;
+      int newSubtreeSize = newLeftSubtreeSize + 1 + (right ? right->entry()->second.subtreeSize : 0);
       PlayersRankingsTree::EntryPtr new_entry;
-      if (entry->second.leftSubtreeSize != newLeftSubtreeSize) {
+      if (entry->second.leftSubtreeSize != newLeftSubtreeSize || entry->second.subtreeSize != newSubtreeSize) {
          // create new entry with updated value
-         new_entry = PlayersRankingsTree::makeEntry(entry->first, RankingData{ entry->second.numEqualRating, newLeftSubtreeSize });
+         new_entry = rankingEntryMakerFn(PlayersRankingsTree::Entry{ entry->first, RankingData{ newLeftSubtreeSize, newSubtreeSize } });
       } else {
          new_entry = entry;
       }
 
-      auto* node = rankingNodeAlloc.Allocate();
-      node->color = color;
-      node->entry = new_entry;
-      node->left = left;
-      node->right = right;
+      auto* node = arenas->rankingNodeAlloc.Allocate();
+      node->link(color, new_entry, left, right);
       return node;
    };
-   rankingHistory.emplace_back(PlayersRankingsTree{ rankingNodeMakerFn }, rankingNodeAlloc.GetCurrent());
+   rankings = PlayersRankingsTree{ rankingNodeMakerFn, rankingEntryMakerFn };
+
+   PushVersion(0);
 }
 
 
-void PlayerRankingDB::Impl::RegisterPlayerResult(std::string&& playerName, int playerRating)
+void PlayerRankingDB::Impl::PushVersion(Version version)
+{
+   assert(currentVersion + 1 == history.Size() || history.Size() == 0);
+   history.versions.push_back(version);
+   history.ratings.Push(playersRatings, arenas->playersRatingsNodeAlloc.GetCurrent(), arenas->playersRatingsEntryAlloc.GetCurrent());
+   history.rankings.Push(rankings, arenas->rankingNodeAlloc.GetCurrent(), arenas->rankingEntryAlloc.GetCurrent());
+   history.namesHeapBytes.push_back(namesHeapBytes);
+   history.liveNamesHeapBytes.push_back(liveNamesHeapBytes);
+   currentVersion = history.Size() - 1;
+   Publish();
+}
+
+
+void PlayerRankingDB::Impl::RestoreVersion(size_t version)
+{
+   playersRatings = history.ratings.View(playersRatings, version);
+   rankings = history.rankings.View(rankings, version);
+   liveNamesHeapBytes = history.liveNamesHeapBytes[version];
+   currentVersion = version;
+   Publish();
+}
+
+
+void PlayerRankingDB::Impl::Publish()
+{
+   if (!options.concurrentReads) {
+      // nobody reads concurrently, so there's nothing to retire
+      published.store(nullptr);
+      publishedHolder.reset();
+      return;
+   }
+   PublishCurrent();
+}
+
+
+void PlayerRankingDB::Impl::PublishCurrent()
 {
-   // store or update new player rating information
-   PlayersRatingsTree&& newPlayerRatings = GetCurrentRatings().insert(std::move(playerName), playerRating);
-   playersRatingsHistory.emplace_back(std::move(newPlayerRatings), playersRatingsNodeAlloc.GetCurrent());
+   auto newPublished = std::make_shared<PublishedVersion>();
+   newPublished->version = history.versions[currentVersion];
+   newPublished->ratings = history.ratings.ReadOnlyView(currentVersion);
+   newPublished->rankings = history.rankings.ReadOnlyView(currentVersion);
+   newPublished->arenas = arenas;
+   newPublished->sharedArenas.assign(sharedArenas.begin(), sharedArenas.end());
+
+   published.store(newPublished.get());
+   if (publishedHolder) {
+      reclaimer.Retire(std::move(publishedHolder));
+   }
+   publishedHolder = std::move(newPublished);
 
-   int numEqualRanking = 1;
-   auto rankingDataOpt = GetCurrentRankings().get(playerRating);
-   if (rankingDataOpt) {
-      numEqualRanking = rankingDataOpt->second.numEqualRating + 1;
+   publishedVersions.push_back(publishedHolder);
+   if (++unprunedVersions > publishedVersions.size() / 2) {
+      // records are released soon after being replaced unless snapshot holds them
+      publishedVersions.erase(std::remove_if(publishedVersions.begin(), publishedVersions.end(), [] (const auto& version) { return version.expired(); }), publishedVersions.end());
+      unprunedVersions = 0;
    }
+}
 
-   PlayersRankingsTree&& newPlayerRankings = GetCurrentRankings().insert(playerRating, RankingData{ numEqualRanking, 0 });
-   rankingHistory.emplace_back(std::move(newPlayerRankings), rankingNodeAlloc.GetCurrent()); // tree sizes will be recalculated on insertion
 
+std::shared_ptr<const PlayerRankingDB::PublishedVersion> PlayerRankingDB::Impl::GetPublished()
+{
+   if (!publishedHolder) {
+      PublishCurrent();
+   }
+   return publishedHolder;
 }
 
 
-void PlayerRankingDB::Impl::UnregisterPlayer(const std::string& playerName)
+template <class Fn>
+auto PlayerRankingDB::Impl::ReadCurrent(Fn&& fn) const
 {
-   // remove player rating information
-   auto ratingOpt = GetCurrentRatings().get(playerName);
-   if (!ratingOpt) {
+   if (!options.concurrentReads) {
+      return fn(playersRatings, rankings);
+   }
+   auto guard = PinForRead();
+   const auto* current = published.load();
+   return fn(current->ratings, current->rankings);
+}
+
+
+bool PlayerRankingDB::Impl::IsPublishedAfter(Version version)
+{
+   return std::any_of(publishedVersions.begin(), publishedVersions.end(), [version] (const auto& weakPublished) {
+      auto published = weakPublished.lock();
+      return published && published->version > version;
+   });
+}
+
+
+EpochReclaimer::ReadGuard PlayerRankingDB::Impl::PinForRead() const
+{
+   if (!options.concurrentReads) {
+      return EpochReclaimer::ReadGuard();
+   }
+   return EpochReclaimer::ReadGuard(reclaimer);
+}
+
+
+void PlayerRankingDB::Impl::DiscardRedo()
+{
+   if (currentVersion + 1 == history.Size()) {
       return;
    }
-   auto rankingDataOpt = GetCurrentRankings().get(ratingOpt->second);
-   assert(rankingDataOpt);
-   int numEqualRatingLeft = rankingDataOpt->second.numEqualRating - 1;
-   if (numEqualRatingLeft == 0) {
-      // remove last entry with such rating
-      PlayersRankingsTree&& newPlayerRankings = GetCurrentRankings().remove(ratingOpt->second);
-      rankingHistory.emplace_back(std::move(newPlayerRankings), rankingNodeAlloc.GetCurrent());
-   } else {
-      // remove node with such rating and reinsert with decreased
-      PlayersRankingsTree temp = GetCurrentRankings().remove(ratingOpt->second);
-      PlayersRankingsTree&& newPlayerRankings = temp.insert(ratingOpt->second, RankingData{ numEqualRatingLeft, 0 });
-      rankingHistory.emplace_back(std::move(newPlayerRankings), rankingNodeAlloc.GetCurrent());
+   // rolled back versions are dropped only now, so arenas are reused lazily on first write after Rollback
+   history.Truncate(currentVersion + 1);
+   if (!reclaimer.Reclaim() || IsPublishedAfter(GetVersion())) {
+      // readers may still traverse rolled back versions through retired published records or snapshots
+      // may hold them, so their memory isn't reused - it's left as garbage to be dropped by next compaction
+      return;
    }
+   arenas->playersRatingsNodeAlloc.ReleaseUpTo(history.ratings.nodeAllocTops.back());
+   arenas->playersRatingsEntryAlloc.ReleaseUpTo(history.ratings.entryAllocTops.back());
+   arenas->rankingNodeAlloc.ReleaseUpTo(history.rankings.nodeAllocTops.back());
+   arenas->rankingEntryAlloc.ReleaseUpTo(history.rankings.entryAllocTops.back());
+   namesHeapBytes = history.namesHeapBytes.back();
+}
+
 
-   PlayersRatingsTree&& newPlayerRatings = GetCurrentRatings().remove(playerName);
-   playersRatingsHistory.emplace_back(std::move(newPlayerRatings), playersRatingsNodeAlloc.GetCurrent());
+void PlayerRankingDB::Impl::DropOldestVersions(size_t count)
+{
+   assert(count <= currentVersion);
+   history.EraseFront(count);
+   currentVersion -= count;
 }
 
 
-void PlayerRankingDB::Impl::Rollback(int step)
+void PlayerRankingDB::Impl::RegisterPlayerResult(std::string&& playerName, int playerRating)
 {
-   assert(step >= 0);
-   size_t historyNewSize = std::max(1U, playersRatingsHistory.size() - step);
+   if (SetPlayerRating(std::move(playerName), playerRating)) {
+      Commit();
+   }
+}
 
-   playersRatingsHistory.resize(historyNewSize);
-   playersRatingsNodeAlloc.ReleaseUpTo(playersRatingsHistory.back().nodeAllocTop);
 
-   rankingHistory.resize(historyNewSize);
-   rankingNodeAlloc.ReleaseUpTo(rankingHistory.back().nodeAllocTop);
+void PlayerRankingDB::Impl::UnregisterPlayer(const std::string& playerName)
+{
+   if (RemovePlayer(playerName)) {
+      Commit();
+   }
 }
 
 
-int PlayerRankingDB::Impl::GetPlayerRank(const std::string& playerName) const
+void PlayerRankingDB::Impl::ApplyBatch(std::vector<WriteCommand>&& commands)
 {
-   auto ratingOpt = GetCurrentRatings().get(playerName);
-   if (!ratingOpt) {
-      return 0;
+   if (ApplyCommands(std::move(commands))) {
+      Commit();
    }
+}
 
-   int ranking = 0;
-   auto lookupCb = [&ranking] (const PlayersRankingsTree::Entry& entryFrom, bool toLeft) {
-      if (!toLeft) {
-         ranking += entryFrom.second.leftSubtreeSize + entryFrom.second.numEqualRating;
+
+bool PlayerRankingDB::Impl::ApplyCommands(std::vector<WriteCommand>&& commands)
+{
+   // only the last command of each player is visible in resulting version, earlier ones are skipped
+   std::unordered_map<std::string_view, size_t> lastCommands;
+   if (commands.size() > 1) {
+      for (size_t i = 0; i < commands.size(); ++i) {
+         lastCommands[commands[i].playerName] = i;
       }
-   };
-   auto rankingDataOpt = GetCurrentRankings().get(ratingOpt->second, lookupCb);
-   assert(rankingDataOpt);
-   ranking += rankingDataOpt->second.leftSubtreeSize;
+   }
 
-   return ranking + 1; // ranking numeration starts from 1
+   bool changed = false;
+   for (size_t i = 0; i < commands.size(); ++i) {
+      auto& command = commands[i];
+      if (!lastCommands.empty() && lastCommands[command.playerName] != i) {
+         continue;
+      }
+      if (command.playerRating) {
+         changed |= SetPlayerRating(std::move(command.playerName), *command.playerRating);
+      } else {
+         changed |= RemovePlayer(command.playerName);
+      }
+   }
+   return changed;
 }
 
 
-PlayerRankingDB::PlayerRankingDB (void)
-   : impl(std::make_unique<Impl>())
-{}
+bool PlayerRankingDB::Impl::BulkLoad(std::vector<std::pair<std::string, int>>&& players, size_t threadsCount)
+{
+   threadsCount = Parallel::GetThreadsCount(threadsCount);
+   SortUnique(players, threadsCount);
+   return LoadSorted(std::move(players), threadsCount);
+}
 
 
-PlayerRankingDB::~PlayerRankingDB ()
-{}
+void PlayerRankingDB::Impl::SortUnique(std::vector<std::pair<std::string, int>>& players, size_t threadsCount)
+{
+   Parallel::StableSort(players.begin(), players.end(), [] (const auto& left, const auto& right) { return left.first < right.first; }, threadsCount);
+   size_t count = 0;
+   for (size_t i = 0; i < players.size(); ++i) {
+      if (count != 0 && players[count - 1].first == players[i].first) {
+         players[count - 1].second = players[i].second;
+      } else if (count++ != i) {
+         players[count - 1] = std::move(players[i]);
+      }
+   }
+   players.resize(count);
+}
 
 
-void PlayerRankingDB::RegisterPlayerResult(std::string playerName, int playerRating)
+bool PlayerRankingDB::Impl::LoadSnapshot(const std::string& path, size_t threadsCount)
 {
-   impl->RegisterPlayerResult(std::move(playerName), playerRating);
+   Version savedVersion = 0;
+   std::vector<std::pair<std::string, int>> players;
+   if (!SnapshotFormat::Read(path, savedVersion, players)) {
+      return false;
+   }
+   // loaded version keeps saved id if possible, so ids of versions written after it still match
+   const Version previousLastVersion = lastVersion;
+   if (savedVersion > lastVersion) {
+      lastVersion = savedVersion - 1;
+   }
+   if (!LoadSorted(std::move(players), Parallel::GetThreadsCount(threadsCount))) {
+      lastVersion = previousLastVersion;
+      return false;
+   }
+   return true;
 }
 
 
-void PlayerRankingDB::UnregisterPlayer(const std::string& playerName)
+bool PlayerRankingDB::Impl::ImportPlayers(const std::string& path, char separator, size_t threadsCount)
 {
-   impl->UnregisterPlayer(playerName);
+   threadsCount = Parallel::GetThreadsCount(threadsCount);
+   CsvFormat::Reader reader;
+   if (!reader.Open(path, separator)) {
+      return false;
+   }
+
+   // duplicates are dropped whenever they may take half of collected players,
+   // so memory is bounded by number of distinct players rather than by file size
+   const size_t minUniqueBatch = 1 << 20;
+   std::vector<std::pair<std::string, int>> players;
+   size_t uniqueCount = 0;
+   std::string_view name;
+   int rating = 0;
+   while (reader.Next(name, rating)) {
+      if (players.size() >= 2 * std::max(uniqueCount, minUniqueBatch)) {
+         SortUnique(players, threadsCount);
+         uniqueCount = players.size();
+      }
+      players.emplace_back(std::string(name), rating);
+   }
+   if (reader.IsFailed()) {
+      return false;
+   }
+   SortUnique(players, threadsCount);
+   return LoadSorted(std::move(players), threadsCount);
 }
 
 
-void PlayerRankingDB::Rollback(int step)
+bool PlayerRankingDB::Impl::ApplyChanges(const std::string& path)
 {
-   impl->Rollback(step);
+   Version savedVersion = 0;
+   std::vector<std::pair<std::string, std::optional<int>>> changes;
+   if (!SnapshotFormat::ReadDelta(path, savedVersion, changes)) {
+      return false;
+   }
+   std::vector<WriteCommand> commands;
+   commands.reserve(changes.size());
+   for (auto& [name, rating] : changes) {
+      commands.push_back(WriteCommand{ std::move(name), rating });
+   }
+   bool changed = ApplyCommands(std::move(commands));
+   // like loaded snapshot, applied version keeps saved id if possible - even if it changes nothing
+   if (savedVersion > lastVersion) {
+      DiscardRedo();
+      lastVersion = savedVersion - 1;
+      changed = true;
+   }
+   if (changed) {
+      Commit();
+   }
+   return true;
 }
 
 
-int PlayerRankingDB::GetPlayerRank(const std::string& playerName) const
+bool PlayerRankingDB::Impl::LoadSorted(std::vector<std::pair<std::string, int>>&& players, size_t threadsCount)
+{
+   const size_t count = players.size();
+   // linked nodes are contiguous, so the first one has to reach the last one
+   if (count >= (size_t)PlayersRatingsTree::Node::maxLinkOffset || count >= (size_t)PlayersRankingsTree::Node::maxLinkOffset) {
+      return false;
+   }
+
+   // players in rankings tree order, stable sort by rating keeps equal ones in name order
+   std::vector<size_t> ranked(count);
+   Parallel::For(count, threadsCount, [&] (size_t i) { ranked[i] = i; });
+   Parallel::StableSort(ranked.begin(), ranked.end(), [&players] (size_t left, size_t right) { return players[left].second > players[right].second; }, threadsCount);
+
+   // all nodes are allocated before anything changes, so DB stays as it was if arenas are exhausted
+   auto* ratingsNodesTop = arenas->playersRatingsNodeAlloc.GetCurrent();
+   auto* ratingsEntriesTop = arenas->playersRatingsEntryAlloc.GetCurrent();
+   auto* rankingsNodesTop = arenas->rankingNodeAlloc.GetCurrent();
+   auto* rankingsEntriesTop = arenas->rankingEntryAlloc.GetCurrent();
+   auto* ratingsNodes = arenas->playersRatingsNodeAlloc.Allocate(count);
+   auto* ratingsEntries = arenas->playersRatingsEntryAlloc.Allocate(count);
+   auto* rankingsNodes = arenas->rankingNodeAlloc.Allocate(count);
+   auto* rankingsEntries = arenas->rankingEntryAlloc.Allocate(count);
+   if (!ratingsNodes || !ratingsEntries || !rankingsNodes || !rankingsEntries) {
+      arenas->playersRatingsNodeAlloc.ReleaseUpTo(ratingsNodesTop);
+      arenas->playersRatingsEntryAlloc.ReleaseUpTo(ratingsEntriesTop);
+      arenas->rankingNodeAlloc.ReleaseUpTo(rankingsNodesTop);
+      arenas->rankingEntryAlloc.ReleaseUpTo(rankingsEntriesTop);
+      return false;
+   }
+   // memory of rolled back versions is below new nodes now, so it's not reused but left to next compaction
+   history.Truncate(currentVersion + 1);
+
+   BalancedTreeLinker<PlayersRatingsTree::Node> ratingsLinker(ratingsNodes, count);
+   ratingsLinker.Link(threadsCount, [&] (PlayersRatingsTree::Node* node, size_t i, size_t, size_t, RedBlackTreeNodeColor color, PlayersRatingsTree::NodePtr left, PlayersRatingsTree::NodePtr right) {
+      ratingsEntries[i] = std::move(players[i]);
+      node->link(color, &ratingsEntries[i], left, right);
+   });
+
+   BalancedTreeLinker<PlayersRankingsTree::Node> rankingsLinker(rankingsNodes, count);
+   rankingsLinker.Link(threadsCount, [&] (PlayersRankingsTree::Node* node, size_t i, size_t low, size_t high, RedBlackTreeNodeColor color, PlayersRankingsTree::NodePtr left, PlayersRankingsTree::NodePtr right) {
+      // node of every player is one element of range, so subtree sizes are known without building it first
+      const auto* player = &ratingsEntries[ranked[i]];
+      rankingsEntries[i] = PlayersRankingsTree::Entry{ RankingKey{ player->second, player }, RankingData{ int(i - low), int(high - low) } };
+      node->link(color, &rankingsEntries[i], left, right);
+   });
+
+   liveNamesHeapBytes = GetNamesHeapBytes(ratingsEntries, ratingsEntries + count);
+   namesHeapBytes += liveNamesHeapBytes;
+   playersRatings = playersRatings.withRoot(ratingsLinker.GetRoot(), count);
+   rankings = rankings.withRoot(rankingsLinker.GetRoot(), count);
+   Commit();
+   return true;
+}
+
+
+bool PlayerRankingDB::Impl::SetPlayerRating(std::string&& playerName, int playerRating)
 {
-   return impl->GetPlayerRank(playerName);
+   const auto* oldEntry = FindPlayer(playersRatings, playerName);
+   if (oldEntry && oldEntry->second == playerRating) {
+      return false;
+   }
+   DiscardRedo();
+
+   if (oldEntry) {
+      // player moves from old rating to new one
+      rankings = rankings.remove(RankingKey{ oldEntry->second, oldEntry });
+   }
+   // store or update new player rating information, its ranking references the new entry
+   playersRatings = playersRatings.insert(playerName, playerRating);
+   const auto* newEntry = FindPlayer(playersRatings, playerName);
+   if (!oldEntry) {
+      liveNamesHeapBytes += GetStringHeapBytes(newEntry->first);
+   }
+   rankings = rankings.insert(RankingKey{ playerRating, newEntry }, RankingData{ 0, 0 }); // tree sizes will be recalculated on insertion
+   return true;
 }
 
 
-std::vector<PlayerRankingDB::PlayerInfoRow> PlayerRankingDB::GetPlayersInfo (void) const
+bool PlayerRankingDB::Impl::RemovePlayer(const std::string& playerName)
 {
-   std::vector<PlayerInfoRow> rows;
+   // remove player rating information
+   const auto* entry = FindPlayer(playersRatings, playerName);
+   if (!entry) {
+      return false;
+   }
+   DiscardRedo();
+
+   liveNamesHeapBytes -= GetStringHeapBytes(entry->first);
+   rankings = rankings.remove(RankingKey{ entry->second, entry });
+   playersRatings = playersRatings.remove(playerName);
+   return true;
+}
+
 
-   const Impl::PlayersRatingsTree& ratings = impl->GetCurrentRatings();
-   rows.reserve(ratings.getSize());
+void PlayerRankingDB::Impl::Commit()
+{
+   PushVersion(++lastVersion);
+   LimitHistory();
+}
 
-   auto ratingsMap = ratings.toMap();
-   for (const auto& ratingInfo : ratingsMap) {
-      int ranking = GetPlayerRank(ratingInfo.first);
-      rows.push_back(PlayerInfoRow{ ratingInfo.first, ratingInfo.second, ranking });
+
+void PlayerRankingDB::Impl::TrimHistory()
+{
+   if (options.maxHistoryDepth != 0 && currentVersion > options.maxHistoryDepth) {
+      // history is trimmed lazily on writes, so drop versions older than allowed right now
+      DropOldestVersions(currentVersion - options.maxHistoryDepth);
    }
+}
 
-   return rows;
+
+void PlayerRankingDB::Impl::Rollback(int step)
+{
+   assert(step >= 0);
+   TrimHistory();
+   RestoreVersion(currentVersion - std::min<size_t>(step, currentVersion));
+}
+
+
+void PlayerRankingDB::Impl::Redo(int step)
+{
+   assert(step >= 0);
+   RestoreVersion(currentVersion + std::min<size_t>(step, history.Size() - 1 - currentVersion));
+}
+
+
+auto PlayerRankingDB::Impl::GetRollbackVersion(int step) const -> Version
+{
+   assert(step >= 0);
+   // Rollback trims history first, so it stops at the oldest version allowed to be kept
+   const size_t firstRetained = options.maxHistoryDepth != 0 && currentVersion > options.maxHistoryDepth ? currentVersion - options.maxHistoryDepth : 0;
+   return history.versions[currentVersion - std::min<size_t>(step, currentVersion - firstRetained)];
+}
+
+
+bool PlayerRankingDB::Impl::RollbackTo(Version version)
+{
+   TrimHistory();
+   size_t index = history.Find(version);
+   if (index == history.Size()) {
+      return false;
+   }
+   RestoreVersion(index);
+   return true;
+}
+
+
+void PlayerRankingDB::Impl::LimitHistory()
+{
+   const size_t maxDepth = options.maxHistoryDepth;
+   const size_t depth = currentVersion;
+   if (maxDepth == 0 || depth <= maxDepth) {
+      return;
+   }
+
+   size_t firstRetained = depth - maxDepth;
+   if (arenas->GetUsedBytes() >= 2 * compactedBytes) {
+      // most of arenas is taken by dropped versions - copy retained ones to fresh arenas
+      CompactHistory(firstRetained);
+   } else if (depth >= 2 * maxDepth) {
+      // drop versions in batches to not shift history on every write,
+      // their nodes are reclaimed on next compaction
+      DropOldestVersions(firstRetained);
+   }
+}
+
+
+void PlayerRankingDB::Impl::CompactHistory(size_t firstRetained)
+{
+   auto newArenas = std::make_shared<Arenas>(options);
+   // entries can't be moved out of arenas still shared with forks or observed by readers and snapshots -
+   // arenas must be referenced only by this DB and its current version record, which nobody else holds
+   const bool moveEntries = arenas.use_count() == (publishedHolder ? 2 : 1) && publishedHolder.use_count() <= 1 && !options.concurrentReads;
+
+   ArenaCompactor<PlayersRatingsTree> ratingsCompactor(arenas->playersRatingsNodeAlloc, arenas->playersRatingsEntryAlloc, newArenas->playersRatingsNodeAlloc, newArenas->playersRatingsEntryAlloc, moveEntries);
+   CompactHistory(history.ratings, playersRatings, firstRetained, ratingsCompactor, newArenas->playersRatingsNodeAlloc, newArenas->playersRatingsEntryAlloc);
+
+   // rankings reference ratings entries of the same versions, all of them are copied by now
+   ArenaCompactor<PlayersRankingsTree> rankingsCompactor(arenas->rankingNodeAlloc, arenas->rankingEntryAlloc, newArenas->rankingNodeAlloc, newArenas->rankingEntryAlloc, moveEntries, [&ratingsCompactor] (PlayersRankingsTree::Entry& entry) {
+      entry.first.player = ratingsCompactor.Forward(entry.first.player);
+   });
+   CompactHistory(history.rankings, rankings, firstRetained, rankingsCompactor, newArenas->rankingNodeAlloc, newArenas->rankingEntryAlloc);
+
+   history.versions.erase(history.versions.begin(), history.versions.begin() + firstRetained);
+   history.namesHeapBytes.erase(history.namesHeapBytes.begin(), history.namesHeapBytes.begin() + firstRetained);
+   history.liveNamesHeapBytes.erase(history.liveNamesHeapBytes.begin(), history.liveNamesHeapBytes.begin() + firstRetained);
+   currentVersion -= firstRetained;
+
+   // only copies of entries retained versions reach are left, count names of each version's share of new arena
+   const auto* entriesBegin = newArenas->playersRatingsEntryAlloc.GetStart();
+   namesHeapBytes = 0;
+   for (size_t i = 0; i < history.Size(); ++i) {
+      namesHeapBytes += GetNamesHeapBytes(entriesBegin, history.ratings.entryAllocTops[i]);
+      history.namesHeapBytes[i] = namesHeapBytes;
+      entriesBegin = history.ratings.entryAllocTops[i];
+   }
+
+   // every retained node is in new arenas now, old ones are released with records of old versions -
+   // unless shared with forks, once readers have left and snapshots are dropped
+   arenas = std::move(newArenas);
+   sharedArenas.clear();
+
+   RestoreVersion(currentVersion);
+   compactedBytes = arenas->GetUsedBytes();
 }
 
+
+template <class TreeT>
+void PlayerRankingDB::Impl::CompactHistory(TreeJournal<TreeT>& journal, const TreeT& tree, size_t firstRetained, ArenaCompactor<TreeT>& compactor, const BumpAllocator<typename TreeT::Node>& newNodeAlloc, const BumpAllocator<typename TreeT::Entry>& newEntryAlloc)
+{
+   TreeJournal<TreeT> compactedJournal;
+   // oldest versions first, so every version watermark covers all its nodes and Rollback stays valid
+   for (size_t i = firstRetained; i < journal.roots.size(); ++i) {
+      auto newRoot = compactor.Copy(journal.roots[i]);
+      compactedJournal.Push(tree.withRoot(newRoot, journal.sizes[i]), newNodeAlloc.GetCurrent(), newEntryAlloc.GetCurrent());
+   }
+   journal = std::move(compactedJournal);
+}
+
+
+template <class Node>
+static bool WithinLinkReach(std::initializer_list<const BumpAllocator<Node>*> allocs)
+{
+   uintptr_t low = UINTPTR_MAX;
+   uintptr_t high = 0;
+   for (const auto* alloc : allocs) {
+      low = std::min(low, (uintptr_t)alloc->GetStart());
+      high = std::max(high, (uintptr_t)alloc->GetStart() + alloc->GetReservedSize());
+   }
+   return (high - low) / sizeof(Node) < (uintptr_t)Node::maxLinkOffset;
+}
+
+
+bool PlayerRankingDB::Impl::CanShareNodesOf(const Impl& other) const
+{
+   // own nodes link shared ones with 32-bit offsets, so all node arenas have to be close enough in address space
+   auto shareable = [this] (const Arenas& shared) {
+      return WithinLinkReach({ &arenas->playersRatingsNodeAlloc, &shared.playersRatingsNodeAlloc })
+         && WithinLinkReach({ &arenas->rankingNodeAlloc, &shared.rankingNodeAlloc });
+   };
+   if (!shareable(*other.arenas)) {
+      return false;
+   }
+   for (const auto& shared : other.sharedArenas) {
+      if (!shareable(*shared)) {
+         return false;
+      }
+   }
+   return true;
+}
+
+
+auto PlayerRankingDB::Impl::Fork() const -> std::unique_ptr<Impl>
+{
+   auto fork = std::make_unique<Impl>(options);
+   fork->history = History();
+   fork->lastVersion = lastVersion;
+   fork->liveNamesHeapBytes = liveNamesHeapBytes;
+
+   if (fork->CanShareNodesOf(*this)) {
+      // current version nodes become shared with fork, so they must never be reused by this DB
+      arenas->playersRatingsNodeAlloc.Pin(history.ratings.nodeAllocTops[currentVersion]);
+      arenas->playersRatingsEntryAlloc.Pin(history.ratings.entryAllocTops[currentVersion]);
+      arenas->rankingNodeAlloc.Pin(history.rankings.nodeAllocTops[currentVersion]);
+      arenas->rankingEntryAlloc.Pin(history.rankings.entryAllocTops[currentVersion]);
+
+      fork->sharedArenas = sharedArenas;
+      fork->sharedArenas.push_back(arenas);
+      fork->playersRatings = fork->playersRatings.withRoot(playersRatings.getRoot(), playersRatings.getSize());
+      fork->rankings = fork->rankings.withRoot(rankings.getRoot(), rankings.getSize());
+   } else {
+      // arenas are too far from each other - copy current version instead of sharing
+      ArenaCompactor<PlayersRatingsTree> ratingsCopier(arenas->playersRatingsNodeAlloc, arenas->playersRatingsEntryAlloc, fork->arenas->playersRatingsNodeAlloc, fork->arenas->playersRatingsEntryAlloc, false);
+      fork->playersRatings = fork->playersRatings.withRoot(ratingsCopier.Copy(playersRatings.getRoot()), playersRatings.getSize());
+
+      ArenaCompactor<PlayersRankingsTree> rankingsCopier(arenas->rankingNodeAlloc, arenas->rankingEntryAlloc, fork->arenas->rankingNodeAlloc, fork->arenas->rankingEntryAlloc, false, [&ratingsCopier] (PlayersRankingsTree::Entry& entry) {
+         entry.first.player = ratingsCopier.Forward(entry.first.player);
+      });
+      fork->rankings = fork->rankings.withRoot(rankingsCopier.Copy(rankings.getRoot()), rankings.getSize());
+      fork->namesHeapBytes = liveNamesHeapBytes;
+   }
+
+   fork->PushVersion(GetVersion());
+   return fork;
+}
+
+
+int PlayerRankingDB::Impl::GetPlayerRank(const PlayersRatingsTree& ratings, const PlayersRankingsTree& rankings, const std::string& playerName)
+{
+   auto ratingOpt = ratings.get(playerName);
+   if (!ratingOpt) {
+      return 0;
+   }
+
+   return GetRatingRank(rankings, ratingOpt->second);
+}
+
+
+int PlayerRankingDB::Impl::GetRatingRank(const PlayersRankingsTree& rankings, int rating)
+{
+   return (int)CountRatingsAbove(rankings, rating) + 1; // ranking numeration starts from 1
+}
+
+
+size_t PlayerRankingDB::Impl::CountRatingsAbove(const PlayersRankingsTree& rankings, int rating)
+{
+   // players of equal rating are ordered by name, so descent goes down to the first of them
+   size_t count = 0;
+   auto node = rankings.getRoot();
+   while (node) {
+      const auto& entry = *node->entry();
+      if (entry.first.rating > rating) {
+         count += entry.second.leftSubtreeSize + 1;
+         node = node->right();
+      } else {
+         node = node->left();
+      }
+   }
+   return count;
+}
+
+
+auto PlayerRankingDB::Impl::FindPlayer(const PlayersRatingsTree& ratings, const std::string& playerName) -> const PlayersRatingsTree::Entry*
+{
+   auto node = ratings.getRoot();
+   while (node) {
+      int order = playerName.compare(node->entry()->first);
+      if (order < 0) {
+         node = node->left();
+      } else if (order > 0) {
+         node = node->right();
+      } else {
+         return node->entry();
+      }
+   }
+   return nullptr;
+}
+
+
+// Splits tree into in-order segments - single nodes of top `depth` levels and whole subtrees below them
+template <class NodePtr>
+static void SplitInOrder(const NodePtr& node, size_t depth, std::vector<std::pair<NodePtr, bool>>& segments)
+{
+   if (!node) {
+      return;
+   }
+   if (depth == 0) {
+      segments.emplace_back(node, true);
+      return;
+   }
+   SplitInOrder(node->left(), depth - 1, segments);
+   segments.emplace_back(node, false);
+   SplitInOrder(node->right(), depth - 1, segments);
+}
+
+
+auto PlayerRankingDB::Impl::GetPlayersInfo(const PlayersRatingsTree& ratings, const PlayersRankingsTree& rankings, size_t threadsCount) -> std::vector<PlayerInfoRow>
+{
+   size_t splitDepth = 0;
+   while (threadsCount > 1 && ((size_t)1 << splitDepth) < 4 * threadsCount) {
+      ++splitDepth;
+   }
+   std::vector<std::pair<PlayersRatingsTree::NodePtr, bool>> segments;
+   SplitInOrder(ratings.getRoot(), splitDepth, segments);
+
+   // ratings tree doesn't store subtree sizes - count them first to know where rows of each segment start
+   std::vector<size_t> offsets(segments.size() + 1, 0);
+   if (segments.size() == 1) {
+      offsets[1] = ratings.getSize();
+   } else {
+      Parallel::For(segments.size(), threadsCount, [&] (size_t segment) {
+         size_t count = 1;
+         if (segments[segment].second) {
+            count = 0;
+            ratings.withRoot(segments[segment].first, 0).forEach([&count] (const PlayersRatingsTree::Entry&) { ++count; });
+         }
+         offsets[segment + 1] = count;
+      });
+      for (size_t segment = 0; segment < segments.size(); ++segment) {
+         offsets[segment + 1] += offsets[segment];
+      }
+   }
+   assert(offsets.back() == ratings.getSize());
+
+   // ranks of distinct ratings flattened to arrays, so rows don't chase rankings nodes. Ratings are descending
+   std::vector<int> rankingRatings;
+   std::vector<int> rankingRanks;
+   ForEachRanked(rankings, [&] (const PlayersRatingsTree::Entry& entry, int ranking) {
+      if (rankingRatings.empty() || rankingRatings.back() != entry.second) {
+         rankingRatings.push_back(entry.second);
+         rankingRanks.push_back(ranking);
+      }
+   });
+
+   // every row is written to its own slot
+   std::vector<PlayerInfoRow> rows(ratings.getSize());
+   Parallel::For(segments.size(), threadsCount, [&] (size_t segment) {
+      size_t row = offsets[segment];
+      auto addRow = [&] (const PlayersRatingsTree::Entry& entry) {
+         auto ranking = std::lower_bound(rankingRatings.begin(), rankingRatings.end(), entry.second, std::greater<int>());
+         assert(ranking != rankingRatings.end() && *ranking == entry.second);
+         rows[row++] = PlayerInfoRow{ entry.first, entry.second, rankingRanks[ranking - rankingRatings.begin()] };
+      };
+      if (segments[segment].second) {
+         ratings.withRoot(segments[segment].first, offsets[segment + 1] - offsets[segment]).forEach(addRow);
+      } else {
+         addRow(*segments[segment].first->entry());
+      }
+   });
+
+   return rows;
+}
+
+
+auto PlayerRankingDB::Impl::GetPlayersPage(const PlayersRankingsTree& rankings, size_t offset, size_t count) -> std::vector<PlayerInfoRow>
+{
+   std::vector<PlayerInfoRow> rows;
+   if (offset >= rankings.getSize() || count == 0) {
+      return rows;
+   }
+   count = std::min(count, rankings.getSize() - offset);
+   rows.reserve(count);
+
+   // order statistic by subtree sizes, nodes passed on the left follow the found one in ranking order
+   std::vector<PlayersRankingsTree::NodePtr> ancestors;
+   auto node = rankings.getRoot();
+   size_t position = offset;
+   for (;;) {
+      assert(node);
+      const RankingData& data = node->entry()->second;
+      if (position < (size_t)data.leftSubtreeSize) {
+         ancestors.push_back(node);
+         node = node->left();
+      } else if (position > (size_t)data.leftSubtreeSize) {
+         position -= data.leftSubtreeSize + 1;
+         node = node->right();
+      } else {
+         break;
+      }
+   }
+
+   // players above page may share rating of its first one
+   int ranking = GetRatingRank(rankings, node->entry()->first.rating);
+   for (;;) {
+      const RankingKey& key = node->entry()->first;
+      if (!rows.empty() && rows.back().rating != key.rating) {
+         ranking = int(offset + rows.size() + 1);
+      }
+      rows.push_back(PlayerInfoRow{ key.player->first, key.rating, ranking });
+      if (rows.size() == count) {
+         break;
+      }
+      // next is the leftmost node of right subtree or the nearest ancestor passed on the left
+      for (auto child = node->right(); child; child = child->left()) {
+         ancestors.push_back(child);
+      }
+      node = ancestors.back();
+      ancestors.pop_back();
+   }
+
+   return rows;
+}
+
+
+template <class Fn>
+void PlayerRankingDB::Impl::ForEachRanked(const PlayersRankingsTree& rankings, const Fn& fn)
+{
+   // rankings tree is in ranking order already, equal ratings take ranking of the first of them
+   int position = 0;
+   int ranking = 0;
+   const RankingKey* previous = nullptr;
+   rankings.forEach([&] (const PlayersRankingsTree::Entry& entry) {
+      ++position;
+      if (!previous || previous->rating != entry.first.rating) {
+         ranking = position;
+      }
+      previous = &entry.first;
+      fn(*entry.first.player, ranking);
+   });
+}
+
+
+template <class T>
+static PlayerRankingDB::ArenaStats GetArenaStats(const BumpAllocator<T>& alloc)
+{
+   PlayerRankingDB::ArenaStats stats;
+   stats.reservedBytes = alloc.GetReservedSize();
+   stats.committedBytes = alloc.GetCommittedSize();
+   stats.usedBytes = alloc.GetUsedSize();
+   stats.count = alloc.GetCount();
+   return stats;
+}
+
+
+size_t PlayerRankingDB::Impl::GetNamesHeapBytes(const PlayersRatingsTree::Entry* begin, const PlayersRatingsTree::Entry* end)
+{
+   size_t bytes = 0;
+   for (const auto* entry = begin; entry != end; ++entry) {
+      bytes += GetStringHeapBytes(entry->first);
+   }
+   return bytes;
+}
+
+
+auto PlayerRankingDB::Impl::GetMemoryStats() const -> MemoryStats
+{
+   MemoryStats stats;
+   stats.ratingsNodes = GetArenaStats(arenas->playersRatingsNodeAlloc);
+   stats.ratingsEntries = GetArenaStats(arenas->playersRatingsEntryAlloc);
+   stats.rankingsNodes = GetArenaStats(arenas->rankingNodeAlloc);
+   stats.rankingsEntries = GetArenaStats(arenas->rankingEntryAlloc);
+
+   stats.namesHeapBytes = namesHeapBytes;
+
+   // every tree node holds exactly one entry, so live part is defined by trees sizes
+   size_t liveRatingsBytes = GetCurrentRatings().getSize() * (sizeof(PlayersRatingsTree::Node) + sizeof(PlayersRatingsTree::Entry));
+   size_t liveRankingsBytes = GetCurrentRankings().getSize() * (sizeof(PlayersRankingsTree::Node) + sizeof(PlayersRankingsTree::Entry));
+   stats.liveBytes = liveRatingsBytes + liveRankingsBytes + liveNamesHeapBytes;
+
+   size_t usedBytes = stats.ratingsNodes.usedBytes + stats.ratingsEntries.usedBytes + stats.rankingsNodes.usedBytes + stats.rankingsEntries.usedBytes;
+   // live nodes of fork may still be in arenas shared with DB it was forked from
+   size_t liveArenaBytes = liveRatingsBytes + liveRankingsBytes;
+   stats.historyBytes = usedBytes > liveArenaBytes ? usedBytes - liveArenaBytes : 0;
+   // names of entries which only retained versions reach are freed with them too
+   stats.historyBytes += stats.namesHeapBytes > liveNamesHeapBytes ? stats.namesHeapBytes - liveNamesHeapBytes : 0;
+
+   stats.historyDepth = currentVersion;
+   stats.redoDepth = history.Size() - 1 - currentVersion;
+   stats.versionBytes.reserve(history.Size() - 1);
+   for (size_t i = 1; i < history.Size(); ++i) {
+      const auto& ratings = history.ratings;
+      const auto& rankings = history.rankings;
+
+      size_t bytes = 0;
+      bytes += (unsigned char*)ratings.nodeAllocTops[i] - (unsigned char*)ratings.nodeAllocTops[i - 1];
+      bytes += (unsigned char*)ratings.entryAllocTops[i] - (unsigned char*)ratings.entryAllocTops[i - 1];
+      bytes += (unsigned char*)rankings.nodeAllocTops[i] - (unsigned char*)rankings.nodeAllocTops[i - 1];
+      bytes += (unsigned char*)rankings.entryAllocTops[i] - (unsigned char*)rankings.entryAllocTops[i - 1];
+      stats.versionBytes.push_back(bytes);
+   }
+
+   return stats;
+}
+
+
+PlayerRankingDB::PlayerRankingDB (void)
+   : PlayerRankingDB(Options())
+{}
+
+
+PlayerRankingDB::PlayerRankingDB (const Options& options)
+   : impl(std::make_unique<Impl>(options))
+{}
+
+
+PlayerRankingDB::PlayerRankingDB (std::unique_ptr<Impl> impl)
+   : impl(std::move(impl))
+{}
+
+
+PlayerRankingDB::PlayerRankingDB (PlayerRankingDB&&) noexcept = default;
+PlayerRankingDB& PlayerRankingDB::operator= (PlayerRankingDB&&) noexcept = default;
+
+
+PlayerRankingDB::~PlayerRankingDB ()
+{}
+
+
+PlayerRankingDB PlayerRankingDB::Fork (void) const
+{
+   return PlayerRankingDB(impl->Fork());
+}
+
+
+auto PlayerRankingDB::RegisterPlayerResult(std::string playerName, int playerRating) -> Version
+{
+   impl->RegisterPlayerResult(std::move(playerName), playerRating);
+   return impl->GetVersion();
+}
+
+
+auto PlayerRankingDB::UnregisterPlayer(const std::string& playerName) -> Version
+{
+   impl->UnregisterPlayer(playerName);
+   return impl->GetVersion();
+}
+
+
+auto PlayerRankingDB::ApplyBatch(std::vector<WriteCommand> commands) -> Version
+{
+   impl->ApplyBatch(std::move(commands));
+   return impl->GetVersion();
+}
+
+
+auto PlayerRankingDB::BulkLoad(std::vector<std::pair<std::string, int>> players, size_t threadsCount) -> std::optional<Version>
+{
+   if (!impl->BulkLoad(std::move(players), threadsCount)) {
+      return std::nullopt;
+   }
+   return impl->GetVersion();
+}
+
+
+bool PlayerRankingDB::SaveSnapshot(const std::string& path) const
+{
+   return GetSnapshot().Save(path);
+}
+
+
+bool PlayerRankingDB::ExportLeaderboard(std::ostream& out, ExportFormat format) const
+{
+   return GetSnapshot().ExportLeaderboard(out, format);
+}
+
+
+bool PlayerRankingDB::LoadSnapshot(const std::string& path, size_t threadsCount)
+{
+   return impl->LoadSnapshot(path, threadsCount);
+}
+
+
+bool PlayerRankingDB::ImportPlayers(const std::string& path, char separator, size_t threadsCount)
+{
+   return impl->ImportPlayers(path, separator, threadsCount);
+}
+
+
+bool PlayerRankingDB::SaveChanges(const std::string& path, Version fromVersion) const
+{
+   if (!HasVersion(fromVersion)) {
+      return false;
+   }
+   // trees are compared structurally, so subtrees shared by both versions are skipped
+   auto changes = ChangedPlayers(fromVersion, GetVersion());
+   SnapshotFormat::Writer writer;
+   if (!writer.Open(path, GetVersion(), changes.size(), SnapshotFormat::Kind::DELTA)) {
+      return false;
+   }
+   for (const auto& change : changes) {
+      writer.AddChange(change.name, change.toRating);
+   }
+   return writer.Commit();
+}
+
+
+bool PlayerRankingDB::ApplyChanges(const std::string& path)
+{
+   return impl->ApplyChanges(path);
+}
+
+
+void PlayerRankingDB::Rollback(int step)
+{
+   impl->Rollback(step);
+}
+
+
+void PlayerRankingDB::Redo(int step)
+{
+   impl->Redo(step);
+}
+
+
+auto PlayerRankingDB::GetVersion (void) const -> Version
+{
+   if (!impl->options.concurrentReads) {
+      return impl->GetVersion();
+   }
+   auto guard = impl->PinForRead();
+   return impl->published.load()->version;
+}
+
+
+auto PlayerRankingDB::GetLastVersion (void) const -> Version
+{
+   return impl->lastVersion;
+}
+
+
+void PlayerRankingDB::ReserveVersions(Version version)
+{
+   impl->lastVersion = std::max(impl->lastVersion, version);
+}
+
+
+auto PlayerRankingDB::GetRollbackVersion(int step) const -> Version
+{
+   return impl->GetRollbackVersion(step);
+}
+
+
+bool PlayerRankingDB::RollbackTo(Version version)
+{
+   return impl->RollbackTo(version);
+}
+
+
+void PlayerRankingDB::Tag(std::string name)
+{
+   impl->tags[std::move(name)] = impl->GetVersion();
+}
+
+
+bool PlayerRankingDB::RollbackToTag(const std::string& name)
+{
+   auto it = impl->tags.find(name);
+   if (it == impl->tags.end()) {
+      return false;
+   }
+   return impl->RollbackTo(it->second);
+}
+
+
+int PlayerRankingDB::GetPlayerRank(const std::string& playerName) const
+{
+   return impl->ReadCurrent([&playerName] (const auto& ratings, const auto& rankings) {
+      return Impl::GetPlayerRank(ratings, rankings, playerName);
+   });
+}
+
+
+auto PlayerRankingDB::GetMemoryStats (void) const -> MemoryStats
+{
+   return impl->GetMemoryStats();
+}
+
+
+std::vector<PlayerRankingDB::PlayerInfoRow> PlayerRankingDB::GetPlayersInfo (void) const
+{
+   return impl->ReadCurrent([] (const auto& ratings, const auto& rankings) {
+      return Impl::GetPlayersInfo(ratings, rankings);
+   });
+}
+
+
+bool PlayerRankingDB::HasVersion(Version version) const
+{
+   return impl->history.Find(version) != impl->history.Size();
+}
+
+
+int PlayerRankingDB::GetPlayerRankAt(Version version, const std::string& playerName) const
+{
+   size_t index = impl->history.Find(version);
+   if (index == impl->history.Size()) {
+      return 0;
+   }
+   return Impl::GetPlayerRank(impl->history.ratings.ReadOnlyView(index), impl->history.rankings.ReadOnlyView(index), playerName);
+}
+
+
+std::vector<PlayerRankingDB::PlayerInfoRow> PlayerRankingDB::GetPlayersInfoAt(Version version) const
+{
+   size_t index = impl->history.Find(version);
+   if (index == impl->history.Size()) {
+      return {};
+   }
+   return Impl::GetPlayersInfo(impl->history.ratings.ReadOnlyView(index), impl->history.rankings.ReadOnlyView(index));
+}
+
+
+auto PlayerRankingDB::ChangedPlayers(Version fromVersion, Version toVersion) const -> std::vector<PlayerRatingChange>
+{
+   std::vector<PlayerRatingChange> changes;
+
+   size_t fromIndex = impl->history.Find(fromVersion);
+   size_t toIndex = impl->history.Find(toVersion);
+   if (fromIndex == impl->history.Size() || toIndex == impl->history.Size()) {
+      return changes;
+   }
+
+   using Entry = Impl::PlayersRatingsTree::Entry;
+   auto fromRatings = impl->history.ratings.ReadOnlyView(fromIndex);
+   auto toRatings = impl->history.ratings.ReadOnlyView(toIndex);
+   fromRatings.diff(toRatings,
+      [&changes] (const Entry& added) {
+         changes.push_back(PlayerRatingChange{ added.first, std::nullopt, added.second });
+      },
+      [&changes] (const Entry& removed) {
+         changes.push_back(PlayerRatingChange{ removed.first, removed.second, std::nullopt });
+      },
+      [&changes] (const Entry& from, const Entry& to) {
+         changes.push_back(PlayerRatingChange{ from.first, from.second, to.second });
+      });
+
+   return changes;
+}
+
+
+
+auto PlayerRankingDB::GetSnapshot (void) const -> Snapshot
+{
+   if (!impl->options.concurrentReads) {
+      return Snapshot(impl->GetPublished());
+   }
+   auto guard = impl->PinForRead();
+   // published record is alive while guard is held, so it can be referenced from any thread
+   return Snapshot(impl->published.load()->shared_from_this());
+}
+
+
+PlayerRankingDB::Snapshot::Snapshot (std::shared_ptr<const PublishedVersion> version)
+   : version(std::move(version))
+{}
+
+
+auto PlayerRankingDB::Snapshot::GetVersion (void) const -> Version
+{
+   return version->version;
+}
+
+
+size_t PlayerRankingDB::Snapshot::GetPlayersCount (void) const
+{
+   return version->ratings.getSize();
+}
+
+
+int PlayerRankingDB::Snapshot::GetPlayerRank(const std::string& playerName) const
+{
+   return Impl::GetPlayerRank(version->ratings, version->rankings, playerName);
+}
+
+
+std::vector<PlayerRankingDB::PlayerInfoRow> PlayerRankingDB::Snapshot::GetPlayersInfo (void) const
+{
+   return Impl::GetPlayersInfo(version->ratings, version->rankings);
+}
+
+
+std::vector<PlayerRankingDB::PlayerInfoRow> PlayerRankingDB::Snapshot::ExportPlayersInfo(size_t threadsCount) const
+{
+   return Impl::GetPlayersInfo(version->ratings, version->rankings, Parallel::GetThreadsCount(threadsCount));
+}
+
+
+std::vector<PlayerRankingDB::PlayerInfoRow> PlayerRankingDB::Snapshot::GetPlayersPage(size_t offset, size_t count) const
+{
+   return Impl::GetPlayersPage(version->rankings, offset, count);
+}
+
+
+std::optional<int> PlayerRankingDB::Snapshot::GetPlayerRating(const std::string& playerName) const
+{
+   auto ratingOpt = version->ratings.get(playerName);
+   if (!ratingOpt) {
+      return std::nullopt;
+   }
+   return ratingOpt->second;
+}
+
+
+size_t PlayerRankingDB::Snapshot::CountPlayersAbove(int rating) const
+{
+   return Impl::CountRatingsAbove(version->rankings, rating);
+}
+
+
+bool PlayerRankingDB::Snapshot::Save(const std::string& path) const
+{
+   SnapshotFormat::Writer writer;
+   if (!writer.Open(path, version->version, version->ratings.getSize())) {
+      return false;
+   }
+   version->ratings.forEach([&writer] (const Impl::PlayersRatingsTree::Entry& entry) {
+      writer.Add(entry.first, entry.second);
+   });
+   return writer.Commit();
+}
+
+
+bool PlayerRankingDB::Snapshot::SaveLeaderboard(const std::string& path) const
+{
+   // names are referenced in place, rankings tree is in leaderboard order already
+   std::vector<std::pair<const std::string*, int>> players;
+   players.reserve(version->rankings.getSize());
+   version->rankings.forEach([&players] (const Impl::PlayersRankingsTree::Entry& entry) {
+      players.emplace_back(&entry.first.player->first, entry.first.rating);
+   });
+   return LeaderboardFormat::Write(path, version->version, players);
+}
+
+
+bool PlayerRankingDB::Snapshot::ExportLeaderboard(std::ostream& out, ExportFormat format) const
+{
+   const size_t bufferSize = 1 << 20;
+   std::string buffer;
+   buffer.reserve(bufferSize + 1024);
+   if (format == ExportFormat::CSV) {
+      buffer.append("name,rating,ranking\n");
+   } else {
+      Varint::AppendFixed(buffer, version->ratings.getSize(), 8);
+   }
+
+   char number[16];
+   auto appendNumber = [&buffer, &number] (int value) {
+      buffer.append(number, std::to_chars(number, number + sizeof(number), value).ptr);
+   };
+   Impl::ForEachRanked(version->rankings, [&] (const Impl::PlayersRatingsTree::Entry& entry, int ranking) {
+      if (!out) {
+         return;
+      }
+      if (format == ExportFormat::CSV) {
+         CsvFormat::AppendName(buffer, entry.first, ',');
+         buffer.push_back(',');
+         appendNumber(entry.second);
+         buffer.push_back(',');
+         appendNumber(ranking);
+         buffer.push_back('\n');
+      } else {
+         Varint::AppendFixed(buffer, entry.first.size(), 4);
+         buffer.append(entry.first);
+         Varint::AppendFixed(buffer, (uint32_t)entry.second, 4);
+         Varint::AppendFixed(buffer, (uint32_t)ranking, 4);
+      }
+      if (buffer.size() >= bufferSize) {
+         out.write(buffer.data(), buffer.size());
+         buffer.clear();
+      }
+   });
+   out.write(buffer.data(), buffer.size());
+   return !out.fail();
+}
@@ -0,0 +1,133 @@
+#pragma once
+#ifndef _RED_BLACK_TREE_COMPACT_NODE_H_
+#define _RED_BLACK_TREE_COMPACT_NODE_H_
+
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+
+#include "PersistentRedBlackTree.h"
+
+
+// Compact node layout for nodes living in arena: childs are stored as 32-bit offsets (in nodes)
+// relative to the node itself and color is packed into lowest bit of left child offset.
+// With raw entry pointer node takes 16 bytes - 4 nodes per cache line.
+// Offsets are position independent, so both childs must be within +-2^30 nodes from the parent,
+// which holds for nodes of the same arena not larger than that. Linking farther nodes aborts.
+// Node must never be copied after being linked.
+template <typename Node, typename EntryPtr>
+struct RedBlackTreeCompactNodeLinks {
+   using Color = RedBlackTreeNodeColor;
+   using NodePtr = const Node*;
+
+   // max distance between linked nodes, in nodes
+   static constexpr intptr_t maxLinkOffset = intptr_t(1) << 30;
+
+   RedBlackTreeCompactNodeLinks() = default;
+
+   RedBlackTreeCompactNodeLinks(Color color, const EntryPtr& entry, const NodePtr& left, const NodePtr& right)
+   {
+      link(color, entry, left, right);
+   }
+
+   RedBlackTreeCompactNodeLinks(const RedBlackTreeCompactNodeLinks&) = delete;
+   RedBlackTreeCompactNodeLinks& operator=(const RedBlackTreeCompactNodeLinks&) = delete;
+
+   void link(Color color, const EntryPtr& entry, const NodePtr& left, const NodePtr& right)
+   {
+      nodeEntry = entry;
+      leftBits = (encode(left) << 1) | (color == Color::RED ? 1U : 0U);
+      rightBits = encode(right);
+   }
+
+   Color color() const
+   {
+      return (leftBits & 1U) ? Color::RED : Color::BLACK;
+   }
+
+   const EntryPtr& entry() const
+   {
+      return nodeEntry;
+   }
+
+   NodePtr left() const
+   {
+      // arithmetic shift keeps offset sign
+      return decode((int32_t)leftBits >> 1);
+   }
+
+   NodePtr right() const
+   {
+      return decode((int32_t)rightBits);
+   }
+
+private:
+   const Node* self() const
+   {
+      return static_cast<const Node*>(this);
+   }
+
+   uint32_t encode(NodePtr node) const
+   {
+      if (!node) {
+         // node can't be a child of itself, so zero offset is free to mean nil
+         return 0;
+      }
+      intptr_t diff = (intptr_t)node - (intptr_t)self();
+      assert(diff % (intptr_t)sizeof(Node) == 0);
+      intptr_t offset = diff / (intptr_t)sizeof(Node);
+      if (offset < -maxLinkOffset || offset >= maxLinkOffset) {
+         // truncated offset would silently link some other node
+         std::abort();
+      }
+      return (uint32_t)(int32_t)offset;
+   }
+
+   NodePtr decode(int32_t offset) const
+   {
+      if (offset == 0) {
+         return nullptr;
+      }
+      return (NodePtr)((intptr_t)self() + (intptr_t)offset * (intptr_t)sizeof(Node));
+   }
+
+   EntryPtr nodeEntry = nullptr;
+   uint32_t leftBits = 0;
+   uint32_t rightBits = 0;
+};
+
+
+// Node maker for arena allocated compact nodes and entries. Nodes have to be allocated by
+// user-provided NodeMakerFn, which links node in place: `node->link(color, entry, left, right)`
+template <typename Node>
+struct RedBlackTreeNodeMakerCompact {
+   using NodePtr = const Node*;
+
+   template <typename Entry>
+   using EntryPtr = const Entry*;
+
+   template <typename EntryPtr>
+   using NodeLinks = RedBlackTreeCompactNodeLinks<Node, EntryPtr>;
+
+   template <typename EntryPtr>
+   using NodeMakerFn = std::function<NodePtr(RedBlackTreeNodeColor color, const EntryPtr& entry, const NodePtr& left, const NodePtr& right)>;
+
+   template <typename Entry>
+   using EntryMakerFn = std::function<EntryPtr<Entry>(Entry&& entry)>;
+
+   template <typename EntryPtr>
+   static NodePtr make(RedBlackTreeNodeColor color, const EntryPtr& entry, const NodePtr& left, const NodePtr& right)
+   {
+      return nullptr;
+   }
+
+   template <typename Entry>
+   static EntryPtr<Entry> makeEntry(Entry&& entry)
+   {
+      return nullptr;
+   }
+};
+
+
+#endif // _RED_BLACK_TREE_COMPACT_NODE_H_
@@ -0,0 +1,186 @@
+#include "ShardedPlayerRankingDB.h"
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <iterator>
+
+
+ShardedPlayerRankingDB::ShardedPlayerRankingDB (size_t shardCount, PlayerRankingDB::Options options)
+{
+   assert(shardCount > 0);
+   // reads don't take shard locks
+   options.concurrentReads = true;
+   shards.reserve(shardCount);
+   for (size_t i = 0; i < shardCount; ++i) {
+      shards.push_back(std::make_unique<Shard>(options));
+   }
+}
+
+
+ShardedPlayerRankingDB::~ShardedPlayerRankingDB ()
+{}
+
+
+auto ShardedPlayerRankingDB::ShardOf(const std::string& playerName) const -> Shard&
+{
+   return *shards[std::hash<std::string>()(playerName) % shards.size()];
+}
+
+
+std::vector<std::unique_lock<std::mutex>> ShardedPlayerRankingDB::LockAll (void) const
+{
+   // always in shard order, so concurrent callers can't deadlock
+   std::vector<std::unique_lock<std::mutex>> locks;
+   locks.reserve(shards.size());
+   for (const auto& shard : shards) {
+      locks.emplace_back(shard->writeMutex);
+   }
+   return locks;
+}
+
+
+void ShardedPlayerRankingDB::RegisterPlayerResult(std::string playerName, int playerRating)
+{
+   Shard& shard = ShardOf(playerName);
+   std::lock_guard<std::mutex> lock(shard.writeMutex);
+   shard.db.RegisterPlayerResult(std::move(playerName), playerRating);
+}
+
+
+void ShardedPlayerRankingDB::UnregisterPlayer(const std::string& playerName)
+{
+   Shard& shard = ShardOf(playerName);
+   std::lock_guard<std::mutex> lock(shard.writeMutex);
+   shard.db.UnregisterPlayer(playerName);
+}
+
+
+auto ShardedPlayerRankingDB::GetVersion (void) const -> VersionVector
+{
+   auto locks = LockAll();
+   VersionVector version;
+   version.reserve(shards.size());
+   for (const auto& shard : shards) {
+      version.push_back(shard->db.GetVersion());
+   }
+   return version;
+}
+
+
+bool ShardedPlayerRankingDB::RollbackTo(const VersionVector& version)
+{
+   if (version.size() != shards.size()) {
+      return false;
+   }
+   auto locks = LockAll();
+   for (size_t i = 0; i < shards.size(); ++i) {
+      if (!shards[i]->db.HasVersion(version[i])) {
+         return false;
+      }
+   }
+   for (size_t i = 0; i < shards.size(); ++i) {
+      shards[i]->db.RollbackTo(version[i]);
+   }
+   return true;
+}
+
+
+int ShardedPlayerRankingDB::GetPlayerRank(const std::string& playerName) const
+{
+   // shards read one by one could count a write without writes completed before it
+   return GetSnapshot().GetPlayerRank(playerName);
+}
+
+
+auto ShardedPlayerRankingDB::GetSnapshot (void) const -> Snapshot
+{
+   Snapshot snapshot;
+   snapshot.shards.reserve(shards.size());
+   snapshot.version.reserve(shards.size());
+
+   auto locks = LockAll();
+   for (const auto& shard : shards) {
+      snapshot.shards.push_back(shard->db.GetSnapshot());
+      snapshot.version.push_back(snapshot.shards.back().GetVersion());
+   }
+   return snapshot;
+}
+
+
+size_t ShardedPlayerRankingDB::Snapshot::GetPlayersCount (void) const
+{
+   size_t count = 0;
+   for (const auto& shard : shards) {
+      count += shard.GetPlayersCount();
+   }
+   return count;
+}
+
+
+int ShardedPlayerRankingDB::Snapshot::GetRatingRank(int rating) const
+{
+   size_t ranking = 1;
+   for (const auto& shard : shards) {
+      ranking += shard.CountPlayersAbove(rating);
+   }
+   return (int)ranking;
+}
+
+
+int ShardedPlayerRankingDB::Snapshot::GetPlayerRank(const std::string& playerName) const
+{
+   // name hash isn't needed - player is registered in one shard at most
+   for (const auto& shard : shards) {
+      auto ratingOpt = shard.GetPlayerRating(playerName);
+      if (ratingOpt) {
+         return GetRatingRank(*ratingOpt);
+      }
+   }
+   return 0;
+}
+
+
+std::vector<ShardedPlayerRankingDB::PlayerInfoRow> ShardedPlayerRankingDB::Snapshot::GetPlayersInfo (void) const
+{
+   std::vector<PlayerInfoRow> rows;
+   rows.reserve(GetPlayersCount());
+   for (const auto& shard : shards) {
+      auto shardRows = shard.GetPlayersInfo();
+      std::move(shardRows.begin(), shardRows.end(), std::back_inserter(rows));
+   }
+   for (auto& row : rows) {
+      row.ranking = GetRatingRank(row.rating);
+   }
+   std::sort(rows.begin(), rows.end(), [] (const PlayerInfoRow& left, const PlayerInfoRow& right) {
+      return left.name < right.name;
+   });
+   return rows;
+}
+
+
+std::vector<ShardedPlayerRankingDB::PlayerInfoRow> ShardedPlayerRankingDB::Snapshot::GetPlayersPage(size_t offset, size_t count) const
+{
+   std::vector<PlayerInfoRow> rows;
+   size_t playersCount = GetPlayersCount();
+   if (offset >= playersCount || count == 0) {
+      return rows;
+   }
+   count = std::min(count, playersCount - offset);
+
+   // global page is within first offset + count players of every shard
+   for (const auto& shard : shards) {
+      auto shardRows = shard.GetPlayersPage(0, offset + count);
+      std::move(shardRows.begin(), shardRows.end(), std::back_inserter(rows));
+   }
+   std::sort(rows.begin(), rows.end(), [] (const PlayerInfoRow& left, const PlayerInfoRow& right) {
+      return left.rating != right.rating ? left.rating > right.rating : left.name < right.name;
+   });
+   rows.erase(rows.begin() + offset + count, rows.end());
+   rows.erase(rows.begin(), rows.begin() + offset);
+
+   for (size_t i = 0; i < rows.size(); ++i) {
+      rows[i].ranking = i != 0 && rows[i].rating == rows[i - 1].rating ? rows[i - 1].ranking : GetRatingRank(rows[i].rating);
+   }
+   return rows;
+}
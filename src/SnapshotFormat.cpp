@@ -0,0 +1,214 @@
+#include "SnapshotFormat.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "Checksum.h"
+#include "Varint.h"
+
+
+namespace SnapshotFormat {
+
+static const char     magics[2][8] = { { 'P', 'R', 'D', 'B', 'S', 'N', 'A', 'P' }, { 'P', 'R', 'D', 'B', 'D', 'L', 'T', 'A' } };
+static const uint32_t formatVersion = 1;
+static const size_t   magicSize = 8;
+static const size_t   headerSize = magicSize + 4 + 8 + 8;
+static const size_t   footerSize = 8;
+static const size_t   writeBufferSize = 1 << 20;
+
+
+Writer::~Writer ()
+{
+   if (file != File::invalidHandle) {
+      File::Close(file);
+      File::Remove(tempPath);
+   }
+}
+
+
+bool Writer::Open(const std::string& path, uint64_t version, uint64_t playersCount, Kind kind)
+{
+   assert(file == File::invalidHandle);
+   this->path = path;
+   this->kind = kind;
+   tempPath = path + ".tmp";
+   file = File::Open(tempPath, File::OpenMode::CREATE);
+   if (file == File::invalidHandle) {
+      return false;
+   }
+
+   buffer.reserve(writeBufferSize + 2 * Varint::maxSize);
+   hash = Checksum::initial;
+   expectedCount = playersCount;
+   buffer.append(magics[(size_t)kind], magicSize);
+   Varint::AppendFixed(buffer, formatVersion, 4);
+   Varint::AppendFixed(buffer, version, 8);
+   Varint::AppendFixed(buffer, playersCount, 8);
+   return true;
+}
+
+
+void Writer::Add(const std::string& name, int rating)
+{
+   assert(kind == Kind::FULL);
+   AddName(name);
+   Varint::Append(buffer, Varint::ZigZag(rating));
+   if (buffer.size() >= writeBufferSize) {
+      Flush();
+   }
+}
+
+
+void Writer::AddChange(const std::string& name, std::optional<int> rating)
+{
+   assert(kind == Kind::DELTA);
+   AddName(name);
+   Varint::Append(buffer, rating ? Varint::ZigZag(*rating) + 1 : 0);
+   if (buffer.size() >= writeBufferSize) {
+      Flush();
+   }
+}
+
+
+void Writer::AddName(const std::string& name)
+{
+   assert(count == 0 || previousName < name);
+   size_t shared = std::mismatch(previousName.begin(), previousName.end(), name.begin(), name.end()).first - previousName.begin();
+   Varint::Append(buffer, shared);
+   Varint::Append(buffer, name.size() - shared);
+   Put(name.data() + shared, name.size() - shared);
+
+   previousName.replace(shared, std::string::npos, name, shared, std::string::npos);
+   ++count;
+}
+
+
+bool Writer::Commit (void)
+{
+   assert(file != File::invalidHandle);
+   Flush();
+   // hash covers flushed bytes only, so footer goes in its own write
+   Varint::AppendFixed(buffer, hash, footerSize);
+   Flush();
+
+   bool committed = !failed && count == expectedCount && File::Sync(file);
+   File::Close(file);
+   file = File::invalidHandle;
+   if (committed && File::Rename(tempPath, path)) {
+      return true;
+   }
+   File::Remove(tempPath);
+   return false;
+}
+
+
+void Writer::Put(const void* data, size_t size)
+{
+   if (buffer.size() + size > buffer.capacity()) {
+      Flush();
+      if (size >= writeBufferSize) {
+         hash = Checksum::Update(hash, (const char*)data, size);
+         failed |= !File::Write(file, data, size);
+         return;
+      }
+   }
+   buffer.append((const char*)data, size);
+}
+
+
+void Writer::Flush (void)
+{
+   hash = Checksum::Update(hash, buffer.data(), buffer.size());
+   failed |= !File::Write(file, buffer.data(), buffer.size());
+   buffer.clear();
+}
+
+
+// rating field is decoded by `decodeRating`, which returns false if it's invalid
+template <class Rating, class DecodeRating>
+static bool ReadPlayers(const std::string& path, Kind kind, uint64_t& version, std::vector<std::pair<std::string, Rating>>& players, const DecodeRating& decodeRating)
+{
+   std::string content;
+   if (!File::ReadAll(path, content) || content.size() < headerSize + footerSize) {
+      return false;
+   }
+   const char* data = content.data();
+   const char* end = data + content.size() - footerSize;
+   if (memcmp(data, magics[(size_t)kind], magicSize) != 0 || Varint::DecodeFixed(data + 8, 4) != formatVersion) {
+      return false;
+   }
+   if (Checksum::Of(data, end - data) != Varint::DecodeFixed(end, footerSize)) {
+      return false;
+   }
+   version = Varint::DecodeFixed(data + 12, 8);
+   uint64_t count = Varint::DecodeFixed(data + 20, 8);
+   // every player takes 3 bytes at least, so corrupted count can't cause huge allocation
+   if (count > (uint64_t)(end - data) / 3) {
+      return false;
+   }
+
+   std::vector<std::pair<std::string, Rating>> loaded;
+   loaded.reserve((size_t)count);
+   data += headerSize;
+   for (uint64_t i = 0; i < count; ++i) {
+      uint64_t shared, suffixSize, rating;
+      if (!(data = Varint::Decode(data, end, shared)) || !(data = Varint::Decode(data, end, suffixSize))) {
+         return false;
+      }
+      if (suffixSize > (uint64_t)(end - data)) {
+         return false;
+      }
+      const char* suffix = data;
+      data += suffixSize;
+      Rating decoded;
+      if (!(data = Varint::Decode(data, end, rating)) || !decodeRating(rating, decoded)) {
+         return false;
+      }
+
+      // names must be strictly ascending: suffix starts past previous name or with greater char
+      if (i != 0) {
+         const std::string& previous = loaded.back().first;
+         if (shared > previous.size() || (shared == previous.size() ? suffixSize == 0 : suffixSize == 0 || (unsigned char)suffix[0] <= (unsigned char)previous[shared])) {
+            return false;
+         }
+      } else if (shared != 0) {
+         return false;
+      }
+
+      std::string name;
+      name.reserve((size_t)(shared + suffixSize));
+      if (shared != 0) {
+         name.append(loaded.back().first, 0, (size_t)shared);
+      }
+      name.append(suffix, (size_t)suffixSize);
+      loaded.emplace_back(std::move(name), decoded);
+   }
+   if (data != end) {
+      return false;
+   }
+   players = std::move(loaded);
+   return true;
+}
+
+
+bool Read(const std::string& path, uint64_t& version, std::vector<std::pair<std::string, int>>& players)
+{
+   return ReadPlayers(path, Kind::FULL, version, players, [] (uint64_t value, int& rating) {
+      rating = (int)Varint::UnZigZag(value);
+      return value <= UINT32_MAX;
+   });
+}
+
+
+bool ReadDelta(const std::string& path, uint64_t& version, std::vector<std::pair<std::string, std::optional<int>>>& changes)
+{
+   return ReadPlayers(path, Kind::DELTA, version, changes, [] (uint64_t value, std::optional<int>& rating) {
+      if (value != 0) {
+         rating = (int)Varint::UnZigZag(value - 1);
+      }
+      return value <= (uint64_t)UINT32_MAX + 1;
+   });
+}
+
+} // namespace SnapshotFormat
@@ -0,0 +1,73 @@
+#pragma once
+#ifndef _SNAPSHOT_FORMAT_H_
+#define _SNAPSHOT_FORMAT_H_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "File.h"
+
+
+// Snapshot file of players set, fixed-size integers are little-endian:
+//   header: magic "PRDBSNAP", uint32 format version, uint64 DB version id, uint64 players count
+//   players in ascending name order, each: varint length of prefix shared with previous name,
+//   varint length of the rest of name, the rest of name, zigzag varint rating
+//   footer: uint64 FNV-1a hash of all preceding bytes
+// There are no pointers or tree shape in file, it's loaded by building trees from sorted players.
+// Delta file has the same layout with magic "PRDBDLTA" and lists changed players instead, their ratings
+// are stored as zigzag + 1, 0 means player was removed
+namespace SnapshotFormat {
+
+enum class Kind : unsigned char {
+   FULL = 0,  // all players of a version
+   DELTA = 1, // players changed between two versions
+};
+
+class Writer {
+public:
+   Writer(void) = default;
+   Writer(const Writer&) = delete;
+   Writer& operator=(const Writer&) = delete;
+   // removes incomplete file if Commit wasn't reached
+   ~Writer();
+
+   // file is written next to `path` and replaces it only on Commit
+   bool Open(const std::string& path, uint64_t version, uint64_t playersCount, Kind kind = Kind::FULL);
+   // players must come in ascending name order, exactly `playersCount` of them
+   void Add(const std::string& name, int rating);
+   // player of DELTA file, no rating means player was removed
+   void AddChange(const std::string& name, std::optional<int> rating);
+   // makes file durable and moves it to `path`. Returns false on any I/O error since Open
+   bool Commit(void);
+
+private:
+   void AddName(const std::string& name);
+   void Put(const void* data, size_t size);
+   void Flush(void);
+
+   std::string  path;
+   std::string  tempPath;
+   File::Handle file = File::invalidHandle;
+   bool         failed = false;
+   Kind         kind = Kind::FULL;
+
+   std::string buffer;
+   uint64_t    hash = 0;
+   std::string previousName;
+   uint64_t    expectedCount = 0;
+   uint64_t    count = 0;
+};
+
+
+// players are sorted by name without duplicates. Returns false if file can't be read or is corrupted
+bool Read(const std::string& path, uint64_t& version, std::vector<std::pair<std::string, int>>& players);
+// changes of DELTA file, sorted by name without duplicates
+bool ReadDelta(const std::string& path, uint64_t& version, std::vector<std::pair<std::string, std::optional<int>>>& changes);
+
+} // namespace SnapshotFormat
+
+
+#endif // _SNAPSHOT_FORMAT_H_
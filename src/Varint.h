@@ -0,0 +1,74 @@
+#pragma once
+#ifndef _VARINT_H_
+#define _VARINT_H_
+
+#include <cstdint>
+#include <string>
+
+
+// LEB128 variable-length integers: 7 bits per byte, high bit set on all bytes but the last.
+// Fixed-size integers are little-endian
+namespace Varint {
+
+const size_t maxSize = 10;
+
+inline void Append(std::string& out, uint64_t value)
+{
+   while (value >= 0x80) {
+      out.push_back((char)(value | 0x80));
+      value >>= 7;
+   }
+   out.push_back((char)value);
+}
+
+
+// returns position after decoded value, nullptr if it's truncated or too long
+inline const char* Decode(const char* data, const char* end, uint64_t& value)
+{
+   value = 0;
+   for (unsigned shift = 0; shift < 7 * maxSize && data != end; shift += 7) {
+      uint64_t byte = (unsigned char)*data++;
+      value |= (byte & 0x7F) << shift;
+      if (byte < 0x80) {
+         return data;
+      }
+   }
+   return nullptr;
+}
+
+
+// signed values interleaved as 0, -1, 1, -2, ... so small negative ones stay short
+inline uint64_t ZigZag(int64_t value)
+{
+   return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+
+inline int64_t UnZigZag(uint64_t value)
+{
+   return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+
+// fixed-size little-endian counterparts for headers and sizes known before encoding
+inline void AppendFixed(std::string& out, uint64_t value, size_t size)
+{
+   for (size_t i = 0; i < size; ++i) {
+      out.push_back((char)(value >> (8 * i)));
+   }
+}
+
+
+inline uint64_t DecodeFixed(const char* data, size_t size)
+{
+   uint64_t value = 0;
+   for (size_t i = 0; i < size; ++i) {
+      value |= (uint64_t)(unsigned char)data[i] << (8 * i);
+   }
+   return value;
+}
+
+} // namespace Varint
+
+
+#endif // _VARINT_H_
@@ -0,0 +1,205 @@
+#include "VirtualMemory.h"
+
+#include <cassert>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cstdlib>
+#endif
+
+
+namespace VirtualMemory {
+
+#ifdef _WIN32
+
+size_t GetPageSize()
+{
+   SYSTEM_INFO info;
+   GetSystemInfo(&info);
+   return info.dwAllocationGranularity;
+}
+
+
+size_t GetHugePageSize()
+{
+   size_t largePageSize = GetLargePageMinimum();
+   return largePageSize != 0 ? largePageSize : 2 * MB;
+}
+
+
+static void* ReserveFileBacked(size_t size, const std::string& directory)
+{
+   char path[MAX_PATH];
+   if (GetTempFileNameA(directory.empty() ? "." : directory.c_str(), "prdb", 0, path) == 0) {
+      return nullptr;
+   }
+   HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+   if (file == INVALID_HANDLE_VALUE) {
+      DeleteFileA(path);
+      return nullptr;
+   }
+   // sparse file doesn't take disk space for pages never written
+   DWORD bytes = 0;
+   DeviceIoControl(file, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &bytes, NULL);
+
+   void* ptr = nullptr;
+   HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, NULL);
+   if (mapping != NULL) {
+      // view keeps mapping and file alive after their handles are closed
+      ptr = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+      CloseHandle(mapping);
+   }
+   CloseHandle(file);
+   return ptr;
+}
+
+
+void* Reserve(size_t size, VirtualMemoryPages& pages, const std::string& directory)
+{
+   if (pages == VirtualMemoryPages::FILE_BACKED) {
+      void* ptr = ReserveFileBacked(size, directory);
+      if (ptr) {
+         return ptr;
+      }
+   }
+
+   if (pages == VirtualMemoryPages::HUGE_EXPLICIT) {
+      // large pages can't be committed lazily - whole region is committed (and locked) at once,
+      // requires SeLockMemoryPrivilege
+      void* ptr = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+      if (ptr) {
+         return ptr;
+      }
+   }
+
+   // there is no transparent huge pages on Windows
+   pages = VirtualMemoryPages::REGULAR;
+   return VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_READWRITE);
+}
+
+
+bool Commit(void* ptr, size_t size, VirtualMemoryPages pages)
+{
+   if (pages == VirtualMemoryPages::HUGE_EXPLICIT || pages == VirtualMemoryPages::FILE_BACKED) {
+      // already committed on reservation, file pages are allocated on first write
+      return true;
+   }
+   return VirtualAlloc(ptr, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+}
+
+
+void Release(void* ptr, size_t /*size*/, VirtualMemoryPages pages)
+{
+   if (pages == VirtualMemoryPages::FILE_BACKED) {
+      UnmapViewOfFile(ptr);
+   } else {
+      VirtualFree(ptr, 0, MEM_RELEASE);
+   }
+}
+
+#else
+
+size_t GetPageSize()
+{
+   return (size_t)sysconf(_SC_PAGESIZE);
+}
+
+
+size_t GetHugePageSize()
+{
+   return 2 * MB;
+}
+
+
+static void* ReserveFileBacked(size_t size, const std::string& directory)
+{
+   std::string path = (directory.empty() ? std::string(".") : directory) + "/prdb-arena.XXXXXX";
+   int fd = mkstemp(&path[0]);
+   if (fd < 0) {
+      return nullptr;
+   }
+   // file lives while it's mapped, nothing is left behind after crash
+   unlink(path.c_str());
+   void* ptr = MAP_FAILED;
+   // sparse file doesn't take disk space for pages never written
+   if (ftruncate(fd, (off_t)size) == 0) {
+      ptr = mmap(nullptr, size, PROT_NONE, MAP_SHARED | MAP_NORESERVE, fd, 0);
+   }
+   close(fd);
+   return ptr != MAP_FAILED ? ptr : nullptr;
+}
+
+
+void* Reserve(size_t size, VirtualMemoryPages& pages, const std::string& directory)
+{
+   const int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+
+   if (pages == VirtualMemoryPages::FILE_BACKED) {
+      void* ptr = ReserveFileBacked(size, directory);
+      if (ptr) {
+         return ptr;
+      }
+      pages = VirtualMemoryPages::REGULAR;
+   }
+
+   if (pages == VirtualMemoryPages::HUGE_EXPLICIT) {
+#ifdef MAP_HUGETLB
+      // no MAP_NORESERVE here - huge pages are taken from pool on reservation, otherwise
+      // empty pool would be reported by SIGBUS on first touch instead of failed mmap
+      void* ptr = mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (ptr != MAP_FAILED) {
+         return ptr;
+      }
+#endif
+      // no huge pages pool configured - fallback to transparent huge pages
+      pages = VirtualMemoryPages::HUGE_TRANSPARENT;
+   }
+
+   if (pages == VirtualMemoryPages::HUGE_TRANSPARENT) {
+      // over-reserve to align region start to huge page boundary, so every huge page
+      // sized chunk can be backed by single TLB entry
+      const size_t hugePageSize = GetHugePageSize();
+      unsigned char* raw = (unsigned char*)mmap(nullptr, size + hugePageSize, PROT_NONE, flags, -1, 0);
+      if (raw == MAP_FAILED) {
+         return nullptr;
+      }
+      unsigned char* aligned = (unsigned char*)(((uintptr_t)raw + hugePageSize - 1) & ~(uintptr_t)(hugePageSize - 1));
+      if (aligned != raw) {
+         munmap(raw, aligned - raw);
+      }
+      size_t tail = (raw + size + hugePageSize) - (aligned + size);
+      if (tail != 0) {
+         munmap(aligned + size, tail);
+      }
+#ifdef MADV_HUGEPAGE
+      if (madvise(aligned, size, MADV_HUGEPAGE) == 0) {
+         return aligned;
+      }
+#endif
+      pages = VirtualMemoryPages::REGULAR;
+      return aligned;
+   }
+
+   void* ptr = mmap(nullptr, size, PROT_NONE, flags, -1, 0);
+   return ptr != MAP_FAILED ? ptr : nullptr;
+}
+
+
+bool Commit(void* ptr, size_t size, VirtualMemoryPages /*pages*/)
+{
+   return mprotect(ptr, size, PROT_READ | PROT_WRITE) == 0;
+}
+
+
+void Release(void* ptr, size_t size, VirtualMemoryPages /*pages*/)
+{
+   munmap(ptr, size);
+}
+
+#endif
+
+} // namespace VirtualMemory
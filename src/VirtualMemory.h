@@ -0,0 +1,43 @@
+#pragma once
+#ifndef _VIRTUAL_MEMORY_H_
+#define _VIRTUAL_MEMORY_H_
+
+#include <cstddef>
+#include <string>
+
+
+enum class VirtualMemoryPages : unsigned char {
+   REGULAR = 0,          // default OS pages
+   HUGE_TRANSPARENT = 1, // hint OS to back memory with huge pages (madvise(MADV_HUGEPAGE))
+   HUGE_EXPLICIT = 2,    // explicit huge pages (MAP_HUGETLB / MEM_LARGE_PAGES)
+   FILE_BACKED = 3,      // shared mapping of scratch file, so OS writes cold pages back to it instead of swap
+};
+
+
+namespace VirtualMemory {
+
+const size_t KB = 1 << 10;
+const size_t MB = KB << 10;
+const size_t GB = MB << 10;
+const size_t TB = GB << 10;
+
+// granularity of reservations and commits with regular pages
+size_t GetPageSize();
+// size of one huge page (2MB on x86-64)
+size_t GetHugePageSize();
+
+// Reserves address space of `size` bytes without committing physical memory.
+// `pages` is updated to the mode actually granted by OS - explicit huge pages
+// fall back to transparent ones and those to regular ones when not available.
+// File backed pages take sparse scratch file in `directory`, which is deleted by OS once region is
+// released or process exits. They fall back to regular pages if file can't be created
+void* Reserve(size_t size, VirtualMemoryPages& pages, const std::string& directory = std::string());
+// Commits physical memory for [ptr, ptr + size) inside reserved region.
+bool Commit(void* ptr, size_t size, VirtualMemoryPages pages);
+// Releases whole region previously returned by Reserve.
+void Release(void* ptr, size_t size, VirtualMemoryPages pages);
+
+} // namespace VirtualMemory
+
+
+#endif // _VIRTUAL_MEMORY_H_
@@ -1,6 +1,8 @@
 #include <benchmark/benchmark.h>
 
+#include "BumpAllocator.h"
 #include "PersistentRedBlackTree.h"
+#include "RedBlackTreeCompactNode.h"
 
 using TestTree = PersistentRedBlackTree<int, int>;
 
@@ -40,3 +42,67 @@ static void PersistentRedBlackTree_Remove(benchmark::State& state)
 }
 
 BENCHMARK(PersistentRedBlackTree_Remove)->RangeMultiplier(8)->Range(1 << 4, 1 << 16)->Complexity(benchmark::oLogN);
+
+
+static void PersistentRedBlackTree_InsertCompact(benchmark::State& state)
+{
+   using CompactTree = PersistentRedBlackTree<int, int, std::less<int>, RedBlackTreeNodeMakerCompact>;
+
+   BumpAllocator<CompactTree::Node>  nodeAlloc(1 * VirtualMemory::GB, 1 * VirtualMemory::MB);
+   BumpAllocator<CompactTree::Entry> entryAlloc(1 * VirtualMemory::GB, 1 * VirtualMemory::MB);
+
+   auto nodeMakerFn = [&] (CompactTree::NodeColor color, const CompactTree::EntryPtr& entry, const CompactTree::NodePtr& left, const CompactTree::NodePtr& right) -> CompactTree::NodePtr {
+      auto* node = nodeAlloc.Allocate();
+      node->link(color, entry, left, right);
+      return node;
+   };
+   auto entryMakerFn = [&] (CompactTree::Entry&& entry) -> CompactTree::EntryPtr {
+      auto* newEntry = entryAlloc.Allocate();
+      *newEntry = std::move(entry);
+      return newEntry;
+   };
+
+   // generate test data
+   const int N = (int)state.range(0);
+   CompactTree tree{ nodeMakerFn, entryMakerFn };
+   for (int j = 0; j < N; ++j) {
+      tree = tree.insert(j, j);
+   }
+
+   auto* nodeTop = nodeAlloc.GetCurrent();
+   auto* entryTop = entryAlloc.GetCurrent();
+   for (auto _ : state) {
+      tree.insert(N, N);
+
+      // drop inserted version to not run out of reserved arena
+      nodeAlloc.ReleaseUpTo(nodeTop);
+      entryAlloc.ReleaseUpTo(entryTop);
+   }
+
+   state.SetComplexityN(state.range(0));
+}
+
+BENCHMARK(PersistentRedBlackTree_InsertCompact)->RangeMultiplier(8)->Range(1 << 4, 1 << 16)->Complexity(benchmark::oLogN);
+
+
+static void PersistentRedBlackTree_DiffOneChange(benchmark::State& state)
+{
+   // generate test data
+   const int N = (int)state.range(0);
+   TestTree tree;
+   for (int j = 0; j < N; ++j) {
+      tree = tree.insert(j, j);
+   }
+   TestTree changed = tree.insert(N / 2, -1);
+
+   for (auto _ : state) {
+      int changes = 0;
+      auto count = [&changes] (const auto&...) { ++changes; };
+      tree.diff(changed, count, count, count);
+      benchmark::DoNotOptimize(changes);
+   }
+
+   state.SetComplexityN(state.range(0));
+}
+
+BENCHMARK(PersistentRedBlackTree_DiffOneChange)->RangeMultiplier(8)->Range(1 << 4, 1 << 16)->Complexity(benchmark::oLogN);
@@ -1,7 +1,16 @@
 #include <benchmark/benchmark.h>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
 #include <string>
+#include <vector>
 
+#include "AsyncPlayerRankingDB.h"
+#include "LeaderboardReader.h"
 #include "PlayerRankingDB.h"
+#include "ShardedPlayerRankingDB.h"
 
 
 static void PlayerRankingBench_Register(benchmark::State& state)
@@ -76,6 +85,27 @@ static void PlayerRankingBench_GetRank(benchmark::State& state)
 BENCHMARK(PlayerRankingBench_GetRank)->RangeMultiplier(8)->Range(1 << 4, 1 << 16)->Complexity(benchmark::oLogN);
 
 
+static void PlayerRankingBench_GetPlayersPage(benchmark::State& state)
+{
+   // generate test data, players share ratings so page starts in the middle of equal ones
+   const int N = (int)state.range(0);
+
+   PlayerRankingDB db;
+   for (int j = 0; j < N; ++j) {
+      db.RegisterPlayerResult(std::to_string(j), j % 100);
+   }
+   auto snapshot = db.GetSnapshot();
+
+   for (auto _ : state) {
+      benchmark::DoNotOptimize(snapshot.GetPlayersPage(N / 2 + 1, 10));
+   }
+
+   state.SetComplexityN(state.range(0));
+}
+
+BENCHMARK(PlayerRankingBench_GetPlayersPage)->RangeMultiplier(8)->Range(1 << 4, 1 << 16)->Complexity(benchmark::oLogN);
+
+
 static void PlayerRankingBench_RollbackSize(benchmark::State& state)
 {
    // generate test data
@@ -128,3 +158,369 @@ static void PlayerRankingBench_RollbackStep(benchmark::State& state)
 }
 
 BENCHMARK(PlayerRankingBench_RollbackStep)->RangeMultiplier(2)->Range(1, 1 << 5)->Complexity(benchmark::o1);
+
+
+static void PlayerRankingBench_GetRankPages(benchmark::State& state)
+{
+   // generate test data
+   const int N = (int)state.range(0);
+
+   PlayerRankingDB::Options options;
+   options.arenaReserveSize = size_t(16) << 30; // 10M players take GBs per arena between compactions
+   options.arenaPages = (PlayerRankingDB::ArenaPages)state.range(1);
+   options.maxHistoryDepth = 16; // full insertion history of 10M players doesn't fit into memory
+
+   PlayerRankingDB db(options);
+   std::vector<std::string> names;
+   names.reserve(N);
+   for (int j = 0; j < N; ++j) {
+      names.push_back(std::to_string(j));
+      db.RegisterPlayerResult(names.back(), j);
+   }
+
+   // random lookups to touch whole node arenas - that's where TLB misses come from
+   std::mt19937 gen{ 42 };
+   std::uniform_int_distribution<int> dis{ 0, N - 1 };
+
+   for (auto _ : state) {
+      benchmark::DoNotOptimize(db.GetPlayerRank(names[dis(gen)]));
+   }
+}
+
+BENCHMARK(PlayerRankingBench_GetRankPages)
+   ->ArgNames({ "players", "pages" })
+   ->Args({ 1 << 20, (int)PlayerRankingDB::ArenaPages::REGULAR })
+   ->Args({ 1 << 20, (int)PlayerRankingDB::ArenaPages::HUGE_TRANSPARENT })
+   ->Args({ 1 << 20, (int)PlayerRankingDB::ArenaPages::FILE_BACKED })
+   ->Args({ 10000000, (int)PlayerRankingDB::ArenaPages::REGULAR })
+   ->Args({ 10000000, (int)PlayerRankingDB::ArenaPages::HUGE_TRANSPARENT })
+   ->Unit(benchmark::kNanosecond);
+
+
+static void PlayerRankingBench_ConcurrentGetRank(benchmark::State& state)
+{
+   // one DB shared by all benchmark threads, thread 0 also keeps writing
+   static const int N = 1 << 16;
+   static PlayerRankingDB* db = nullptr;
+   if (state.thread_index == 0) {
+      PlayerRankingDB::Options options;
+      options.concurrentReads = true;
+      options.maxHistoryDepth = 1000;
+      db = new PlayerRankingDB(options);
+      for (int j = 0; j < N; ++j) {
+         db->RegisterPlayerResult(std::to_string(j), j);
+      }
+   }
+
+   std::mt19937 gen{ (unsigned)state.thread_index };
+   std::uniform_int_distribution<int> dis{ 0, N - 1 };
+   std::vector<std::string> names;
+   for (int j = 0; j < 1024; ++j) {
+      names.push_back(std::to_string(dis(gen)));
+   }
+
+   size_t i = 0;
+   for (auto _ : state) {
+      if (state.thread_index == 0 && i % 64 == 0) {
+         db->RegisterPlayerResult(names[i % names.size()], dis(gen));
+      }
+      benchmark::DoNotOptimize(db->GetPlayerRank(names[i++ % names.size()]));
+   }
+
+   if (state.thread_index == 0) {
+      delete db;
+      db = nullptr;
+   }
+}
+
+BENCHMARK(PlayerRankingBench_ConcurrentGetRank)->ThreadRange(1, 8)->UseRealTime();
+
+
+static void PlayerRankingBench_ShardedRegister(benchmark::State& state)
+{
+   // writer threads register distinct players, shards count is the first argument
+   static ShardedPlayerRankingDB* db = nullptr;
+   if (state.thread_index == 0) {
+      PlayerRankingDB::Options options;
+      options.maxHistoryDepth = 1000;
+      db = new ShardedPlayerRankingDB((size_t)state.range(0), options);
+   }
+
+   std::mt19937 gen{ (unsigned)state.thread_index };
+   std::uniform_int_distribution<int> dis{ 0, 1 << 20 };
+   std::vector<std::string> names;
+   for (int j = 0; j < 1024; ++j) {
+      names.push_back(std::to_string(state.thread_index) + "/" + std::to_string(j));
+   }
+
+   size_t i = 0;
+   for (auto _ : state) {
+      db->RegisterPlayerResult(names[i++ % names.size()], dis(gen));
+   }
+
+   if (state.thread_index == 0) {
+      delete db;
+      db = nullptr;
+   }
+}
+
+BENCHMARK(PlayerRankingBench_ShardedRegister)->Arg(1)->Arg(8)->ThreadRange(1, 8)->UseRealTime();
+
+
+static void PlayerRankingBench_AsyncRegister(benchmark::State& state)
+{
+   // caller side cost of a write - queue push, writer thread commits in batches meanwhile
+   static AsyncPlayerRankingDB* db = nullptr;
+   if (state.thread_index == 0) {
+      AsyncPlayerRankingDB::Options options;
+      options.db.maxHistoryDepth = 1000;
+      db = new AsyncPlayerRankingDB(options);
+   }
+
+   std::mt19937 gen{ (unsigned)state.thread_index };
+   std::uniform_int_distribution<int> dis{ 0, 1 << 20 };
+   std::vector<std::string> names;
+   for (int j = 0; j < 1024; ++j) {
+      names.push_back(std::to_string(state.thread_index) + "/" + std::to_string(j));
+   }
+
+   size_t i = 0;
+   for (auto _ : state) {
+      db->RegisterPlayerResult(names[i++ % names.size()], dis(gen));
+   }
+
+   if (state.thread_index == 0) {
+      delete db;
+      db = nullptr;
+   }
+}
+
+BENCHMARK(PlayerRankingBench_AsyncRegister)->ThreadRange(1, 8)->UseRealTime();
+
+
+static void PlayerRankingBench_DurableRegister(benchmark::State& state)
+{
+   // every write waits until it's synced to log, concurrent writers share syncs
+   static AsyncPlayerRankingDB* db = nullptr;
+   const std::string directory = "PlayerRankingBench_DurableRegister";
+   if (state.thread_index == 0) {
+      std::filesystem::remove_all(directory);
+      std::filesystem::create_directory(directory);
+      AsyncPlayerRankingDB::Options options;
+      options.db.maxHistoryDepth = 1000;
+      options.durableDirectory = directory;
+      db = new AsyncPlayerRankingDB(options);
+   }
+
+   std::mt19937 gen{ (unsigned)state.thread_index };
+   std::uniform_int_distribution<int> dis{ 0, 1 << 20 };
+   std::vector<std::string> names;
+   for (int j = 0; j < 1024; ++j) {
+      names.push_back(std::to_string(state.thread_index) + "/" + std::to_string(j));
+   }
+
+   size_t i = 0;
+   for (auto _ : state) {
+      db->RegisterPlayerResult(names[i++ % names.size()], dis(gen)).wait();
+   }
+
+   if (state.thread_index == 0) {
+      delete db;
+      db = nullptr;
+      std::filesystem::remove_all(directory);
+   }
+}
+
+BENCHMARK(PlayerRankingBench_DurableRegister)->ThreadRange(1, 8)->UseRealTime();
+
+
+static void PlayerRankingBench_BulkLoad(benchmark::State& state)
+{
+   const int N = 1 << 20;
+   std::mt19937 gen{ 0 };
+   std::uniform_int_distribution<int> dis{ 0, N };
+   std::vector<std::pair<std::string, int>> players;
+   for (int j = 0; j < N; ++j) {
+      players.emplace_back(std::to_string(dis(gen)), dis(gen));
+   }
+
+   std::unique_ptr<PlayerRankingDB> db;
+   for (auto _ : state) {
+      state.PauseTiming();
+      db = std::make_unique<PlayerRankingDB>();
+      auto input = players;
+      state.ResumeTiming();
+
+      db->BulkLoad(std::move(input), (size_t)state.range(0));
+   }
+   state.SetItemsProcessed(state.iterations() * N);
+}
+
+BENCHMARK(PlayerRankingBench_BulkLoad)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+
+static void PlayerRankingBench_ImportPlayers(benchmark::State& state)
+{
+   // the same players as BulkLoad, parsed from CSV file
+   const int N = 1 << 20;
+   const std::string path = "PlayerRankingBench_ImportPlayers.csv";
+   std::mt19937 gen{ 0 };
+   std::uniform_int_distribution<int> dis{ 0, N };
+   {
+      std::ofstream out(path, std::ios::binary);
+      out << "name,rating\n";
+      for (int j = 0; j < N; ++j) {
+         out << dis(gen) << ',' << dis(gen) << '\n';
+      }
+   }
+
+   std::unique_ptr<PlayerRankingDB> db;
+   for (auto _ : state) {
+      state.PauseTiming();
+      db = std::make_unique<PlayerRankingDB>();
+      state.ResumeTiming();
+
+      db->ImportPlayers(path, ',', (size_t)state.range(0));
+   }
+   state.SetItemsProcessed(state.iterations() * N);
+   std::remove(path.c_str());
+}
+
+BENCHMARK(PlayerRankingBench_ImportPlayers)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+
+static void PlayerRankingBench_ExportPlayersInfo(benchmark::State& state)
+{
+   const int N = 1 << 20;
+   std::mt19937 gen{ 0 };
+   std::uniform_int_distribution<int> dis{ 0, N };
+   std::vector<std::pair<std::string, int>> players;
+   for (int j = 0; j < N; ++j) {
+      players.emplace_back(std::to_string(dis(gen)), dis(gen));
+   }
+   PlayerRankingDB db;
+   db.BulkLoad(std::move(players));
+   auto snapshot = db.GetSnapshot();
+
+   for (auto _ : state) {
+      benchmark::DoNotOptimize(snapshot.ExportPlayersInfo((size_t)state.range(0)));
+   }
+   state.SetItemsProcessed(state.iterations() * snapshot.GetPlayersCount());
+}
+
+BENCHMARK(PlayerRankingBench_ExportPlayersInfo)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+
+static void PlayerRankingBench_ExportLeaderboard(benchmark::State& state)
+{
+   // streamed into file in CSV (0) or binary (1) format, compare with ExportPlayersInfo
+   const int N = 1 << 20;
+   const std::string path = "PlayerRankingBench_ExportLeaderboard.bin";
+   std::mt19937 gen{ 0 };
+   std::uniform_int_distribution<int> dis{ 0, N };
+   std::vector<std::pair<std::string, int>> players;
+   for (int j = 0; j < N; ++j) {
+      players.emplace_back(std::to_string(dis(gen)), dis(gen));
+   }
+   PlayerRankingDB db;
+   db.BulkLoad(std::move(players));
+   auto snapshot = db.GetSnapshot();
+
+   for (auto _ : state) {
+      std::ofstream out(path, std::ios::binary | std::ios::trunc);
+      snapshot.ExportLeaderboard(out, (PlayerRankingDB::ExportFormat)state.range(0));
+   }
+   state.SetItemsProcessed(state.iterations() * snapshot.GetPlayersCount());
+   std::remove(path.c_str());
+}
+
+BENCHMARK(PlayerRankingBench_ExportLeaderboard)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+
+static void PlayerRankingBench_LoadSnapshot(benchmark::State& state)
+{
+   const int N = 1 << 20;
+   const std::string path = "PlayerRankingBench_LoadSnapshot.bin";
+   std::mt19937 gen{ 0 };
+   std::uniform_int_distribution<int> dis{ 0, N };
+   std::vector<std::pair<std::string, int>> players;
+   for (int j = 0; j < N; ++j) {
+      players.emplace_back(std::to_string(dis(gen)), dis(gen));
+   }
+   PlayerRankingDB source;
+   source.BulkLoad(std::move(players));
+   source.SaveSnapshot(path);
+
+   std::unique_ptr<PlayerRankingDB> db;
+   for (auto _ : state) {
+      state.PauseTiming();
+      db = std::make_unique<PlayerRankingDB>();
+      state.ResumeTiming();
+
+      db->LoadSnapshot(path, (size_t)state.range(0));
+   }
+   state.SetItemsProcessed(state.iterations() * source.GetSnapshot().GetPlayersCount());
+   std::remove(path.c_str());
+}
+
+BENCHMARK(PlayerRankingBench_LoadSnapshot)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+
+static void PlayerRankingBench_SaveChanges(benchmark::State& state)
+{
+   // checkpoint of 1M players after `range(0)` writes, 0 - full snapshot for comparison
+   const int N = 1 << 20;
+   const std::string path = "PlayerRankingBench_SaveChanges.bin";
+   std::mt19937 gen{ 0 };
+   std::uniform_int_distribution<int> dis{ 0, N - 1 };
+   std::vector<std::pair<std::string, int>> players;
+   for (int j = 0; j < N; ++j) {
+      players.emplace_back(std::to_string(j), dis(gen));
+   }
+   PlayerRankingDB db;
+   db.BulkLoad(std::move(players));
+   auto checkpointVersion = db.GetVersion();
+   for (int j = 0; j < state.range(0); ++j) {
+      db.RegisterPlayerResult(std::to_string(dis(gen)), dis(gen));
+   }
+
+   for (auto _ : state) {
+      if (state.range(0) == 0) {
+         db.SaveSnapshot(path);
+      } else {
+         db.SaveChanges(path, checkpointVersion);
+      }
+   }
+   std::remove(path.c_str());
+}
+
+BENCHMARK(PlayerRankingBench_SaveChanges)->Arg(0)->Arg(1000)->Arg(10000)->Unit(benchmark::kMillisecond);
+
+
+static void PlayerRankingBench_LeaderboardReader(benchmark::State& state)
+{
+   // random rank lookups served from mapped leaderboard file, compare with GetRankPages
+   const int N = 1 << 20;
+   const std::string path = "PlayerRankingBench_LeaderboardReader.bin";
+   std::mt19937 gen{ 0 };
+   std::uniform_int_distribution<int> dis{ 0, N - 1 };
+   std::vector<std::pair<std::string, int>> players;
+   std::vector<std::string> names;
+   for (int j = 0; j < N; ++j) {
+      names.push_back(std::to_string(j));
+      players.emplace_back(names.back(), dis(gen));
+   }
+   PlayerRankingDB db;
+   db.BulkLoad(std::move(players));
+   db.GetSnapshot().SaveLeaderboard(path);
+
+   LeaderboardReader reader;
+   reader.Open(path);
+   for (auto _ : state) {
+      benchmark::DoNotOptimize(reader.GetPlayerRank(names[dis(gen)]));
+   }
+   reader.Close();
+   std::remove(path.c_str());
+}
+
+BENCHMARK(PlayerRankingBench_LeaderboardReader);
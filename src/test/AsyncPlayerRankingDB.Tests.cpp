@@ -0,0 +1,394 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+#include "AsyncPlayerRankingDB.h"
+#include "OperationLog.h"
+
+
+TEST(AsyncPlayerRankingDBTest, WritesAndFlush)
+{
+   AsyncPlayerRankingDB db;
+   auto registered = db.RegisterPlayerResult("A", 10);
+   db.RegisterPlayerResult("B", 20);
+   auto updated = db.RegisterPlayerResult("A", 30);
+   auto unregistered = db.UnregisterPlayer("B");
+
+   auto flushed = db.Flush().get();
+   EXPECT_EQ(flushed, db.GetVersion());
+   EXPECT_GE(flushed, registered.get());
+   EXPECT_GE(unregistered.get(), updated.get());
+   EXPECT_EQ(1, db.GetPlayerRank("A"));
+   EXPECT_EQ(0, db.GetPlayerRank("B"));
+
+   auto rows = db.GetPlayersInfo();
+   ASSERT_EQ(1, rows.size());
+   EXPECT_EQ(30, rows[0].rating);
+}
+
+
+TEST(AsyncPlayerRankingDBTest, RollbackIsOrdered)
+{
+   AsyncPlayerRankingDB::Options options;
+   options.maxBatchSize = 1; // every write is its own version
+   AsyncPlayerRankingDB db(options);
+
+   db.RegisterPlayerResult("A", 10);
+   auto version = db.RegisterPlayerResult("B", 20).get();
+   db.RegisterPlayerResult("C", 30);
+   db.RegisterPlayerResult("D", 40);
+   EXPECT_EQ(version, db.Rollback(2).get());
+   EXPECT_EQ(0, db.GetPlayerRank("C"));
+   EXPECT_EQ(1, db.GetPlayerRank("B"));
+}
+
+
+TEST(AsyncPlayerRankingDBTest, ConcurrentProducers)
+{
+   AsyncPlayerRankingDB::Options options;
+   options.queueCapacity = 64; // producers often find queue full
+   AsyncPlayerRankingDB db(options);
+
+   const int producersCount = 4;
+   const int N = 4000;
+   std::vector<std::thread> producers;
+   for (int t = 0; t < producersCount; ++t) {
+      producers.emplace_back([&db, t] {
+         std::future<AsyncPlayerRankingDB::Version> last;
+         for (int i = t; i < N; i += producersCount) {
+            // intermediate rating is overwritten by the next write of the same thread
+            db.RegisterPlayerResult("player #" + std::to_string(i), -1);
+            last = db.RegisterPlayerResult("player #" + std::to_string(i), i);
+         }
+         last.get();
+      });
+   }
+   for (auto& producer : producers) {
+      producer.join();
+   }
+
+   db.Flush().wait();
+   auto rows = db.GetPlayersInfo();
+   ASSERT_EQ(N, rows.size());
+   for (const auto& row : rows) {
+      ASSERT_EQ(N - row.rating, row.ranking);
+   }
+   // writes were batched
+   EXPECT_LT(db.GetVersion(), 2 * N);
+}
+
+
+TEST(AsyncPlayerRankingDBTest, DestructorAppliesQueued)
+{
+   auto db = std::make_unique<AsyncPlayerRankingDB>();
+   std::vector<std::future<AsyncPlayerRankingDB::Version>> futures;
+   for (int i = 0; i < 1000; ++i) {
+      futures.push_back(db->RegisterPlayerResult("player #" + std::to_string(i), i));
+   }
+   db.reset();
+   for (auto& future : futures) {
+      EXPECT_NE(0, future.get());
+   }
+}
+
+
+static std::string MakeEmptyDirectory(const std::string& name)
+{
+   auto path = std::filesystem::path(::testing::TempDir()) / name;
+   std::filesystem::remove_all(path);
+   std::filesystem::create_directories(path);
+   return path.string();
+}
+
+
+static void ExpectSamePlayers(const std::vector<PlayerRankingDB::PlayerInfoRow>& expected, const AsyncPlayerRankingDB& db)
+{
+   auto rows = db.GetPlayersInfo();
+   ASSERT_EQ(expected.size(), rows.size());
+   for (size_t i = 0; i < rows.size(); ++i) {
+      ASSERT_EQ(expected[i].name, rows[i].name);
+      ASSERT_EQ(expected[i].rating, rows[i].rating);
+      ASSERT_EQ(expected[i].ranking, rows[i].ranking);
+   }
+}
+
+
+TEST(AsyncPlayerRankingDBTest, DurableRecovery)
+{
+   AsyncPlayerRankingDB::Options options;
+   options.durableDirectory = MakeEmptyDirectory("AsyncPlayerRankingDBTest.DurableRecovery");
+   options.maxBatchSize = 1;
+
+   std::vector<PlayerRankingDB::PlayerInfoRow> expected;
+   {
+      AsyncPlayerRankingDB db(options);
+      EXPECT_TRUE(db.GetPlayersInfo().empty());
+      std::vector<std::thread> producers;
+      for (int t = 0; t < 4; ++t) {
+         producers.emplace_back([&db, t] {
+            std::future<AsyncPlayerRankingDB::Version> last;
+            for (int i = t; i < 400; i += 4) {
+               db.RegisterPlayerResult("player #" + std::to_string(i), i % 50);
+               last = db.UnregisterPlayer("player #" + std::to_string(i - 8));
+            }
+            last.get();
+         });
+      }
+      for (auto& producer : producers) {
+         producer.join();
+      }
+      db.Rollback(3);
+      db.RegisterPlayerResult("player #1", 1000);
+      db.Flush().get();
+      expected = db.GetPlayersInfo();
+   }
+
+   // history before restart is replayed, so Rollback steps cover the same writes
+   AsyncPlayerRankingDB db(options);
+   ExpectSamePlayers(expected, db);
+   db.RegisterPlayerResult("player #2", 2000);
+   db.Rollback(2).get();
+   AsyncPlayerRankingDB::Options notDurable = options;
+   notDurable.durableDirectory.clear();
+   {
+      AsyncPlayerRankingDB reference(notDurable);
+      for (const auto& row : expected) {
+         if (row.name != "player #1") {
+            reference.RegisterPlayerResult(row.name, row.rating);
+         }
+      }
+      reference.Flush().get();
+      ExpectSamePlayers(reference.GetPlayersInfo(), db);
+   }
+}
+
+
+TEST(AsyncPlayerRankingDBTest, DurableCheckpoints)
+{
+   AsyncPlayerRankingDB::Options options;
+   options.durableDirectory = MakeEmptyDirectory("AsyncPlayerRankingDBTest.DurableCheckpoints");
+   options.maxBatchSize = 1;
+   options.checkpointLogSize = 2000; // log is checkpointed automatically every few dozens of writes
+   options.incrementalCheckpoints = false;
+
+   std::vector<PlayerRankingDB::PlayerInfoRow> expected;
+   {
+      AsyncPlayerRankingDB db(options);
+      for (int i = 0; i < 300; ++i) {
+         db.RegisterPlayerResult("player #" + std::to_string(i), i);
+      }
+      db.Checkpoint().get();
+      db.UnregisterPlayer("player #0");
+      // reverts writes preceding checkpoint, which saves new one
+      db.Rollback(5).get();
+      db.RegisterPlayerResult("player #1000", 7);
+      db.Flush().get();
+      expected = db.GetPlayersInfo();
+      EXPECT_EQ(297, expected.size());
+   }
+   // files of older checkpoints are removed
+   EXPECT_EQ(2, std::distance(std::filesystem::directory_iterator(options.durableDirectory), std::filesystem::directory_iterator()));
+
+   {
+      AsyncPlayerRankingDB db(options);
+      ExpectSamePlayers(expected, db);
+   }
+   AsyncPlayerRankingDB db(options);
+   ExpectSamePlayers(expected, db);
+}
+
+
+TEST(AsyncPlayerRankingDBTest, DurableIncrementalCheckpoints)
+{
+   AsyncPlayerRankingDB::Options options;
+   options.durableDirectory = MakeEmptyDirectory("AsyncPlayerRankingDBTest.DurableIncrementalCheckpoints");
+   const std::string directory = options.durableDirectory;
+
+   std::vector<PlayerRankingDB::PlayerInfoRow> expected;
+   {
+      AsyncPlayerRankingDB db(options);
+      for (int i = 0; i < 1000; ++i) {
+         db.RegisterPlayerResult("player #" + std::to_string(i), i);
+      }
+      db.Checkpoint().get();
+      EXPECT_TRUE(std::filesystem::exists(directory + "/snapshot.1"));
+
+      // only changed players are saved
+      for (int i = 0; i < 10; ++i) {
+         db.RegisterPlayerResult("player #" + std::to_string(i * 7), -i);
+      }
+      db.Checkpoint().get();
+      db.UnregisterPlayer("player #500");
+      db.RegisterPlayerResult("player #1000", 5);
+      db.Checkpoint().get();
+      EXPECT_FALSE(std::filesystem::exists(directory + "/snapshot.2"));
+      EXPECT_LT(std::filesystem::file_size(directory + "/delta.2") * 20, std::filesystem::file_size(directory + "/snapshot.1"));
+      EXPECT_TRUE(std::filesystem::exists(directory + "/delta.3"));
+      expected = db.GetPlayersInfo();
+   }
+
+   {
+      AsyncPlayerRankingDB db(options);
+      ExpectSamePlayers(expected, db);
+      // deltas grow past half of snapshot, so the next checkpoint merges them
+      for (int i = 0; i < 1000; ++i) {
+         db.RegisterPlayerResult("player #" + std::to_string(i), 2000 - i);
+      }
+      db.Checkpoint().get();
+      EXPECT_TRUE(std::filesystem::exists(directory + "/delta.4"));
+      db.UnregisterPlayer("player #1");
+      db.Checkpoint().get();
+      expected = db.GetPlayersInfo();
+   }
+   EXPECT_TRUE(std::filesystem::exists(directory + "/snapshot.5"));
+   EXPECT_EQ(2, std::distance(std::filesystem::directory_iterator(directory), std::filesystem::directory_iterator()));
+
+   {
+      AsyncPlayerRankingDB db(options);
+      ExpectSamePlayers(expected, db);
+      db.RegisterPlayerResult("player #1", 1).get();
+      db.Checkpoint().get();
+   }
+   // chain can't be recovered without any of its deltas
+   std::filesystem::remove(directory + "/delta.6");
+   EXPECT_THROW(AsyncPlayerRankingDB broken(options), std::runtime_error);
+}
+
+
+TEST(AsyncPlayerRankingDBTest, DurableVersionIds)
+{
+   AsyncPlayerRankingDB::Options options;
+   options.durableDirectory = MakeEmptyDirectory("AsyncPlayerRankingDBTest.DurableVersionIds");
+
+   AsyncPlayerRankingDB::Version version = 0;
+   {
+      AsyncPlayerRankingDB db(options);
+      for (int i = 0; i < 100; ++i) {
+         db.RegisterPlayerResult("player #" + std::to_string(i), i).get();
+      }
+      db.Checkpoint().get();
+      // changes of many versions are saved as one delta
+      for (int i = 0; i < 50; ++i) {
+         db.RegisterPlayerResult("player #" + std::to_string(i), -i).get();
+      }
+      db.Checkpoint().get();
+      EXPECT_TRUE(std::filesystem::exists(options.durableDirectory + "/delta.2"));
+      db.RegisterPlayerResult("player #100", 100).get();
+      version = db.GetVersion();
+   }
+   {
+      AsyncPlayerRankingDB db(options);
+      // ids aren't reused after restart, so versions seen by clients stay ordered
+      EXPECT_EQ(version, db.GetVersion());
+      EXPECT_LT(version, db.RegisterPlayerResult("player #101", 101).get());
+   }
+}
+
+
+TEST(AsyncPlayerRankingDBTest, DurableRollbackVersionIds)
+{
+   AsyncPlayerRankingDB::Options options;
+   options.durableDirectory = MakeEmptyDirectory("AsyncPlayerRankingDBTest.DurableRollbackVersionIds");
+
+   AsyncPlayerRankingDB::Version checkpointed = 0;
+   AsyncPlayerRankingDB::Version rolledBack = 0;
+   AsyncPlayerRankingDB::Version last = 0;
+   {
+      AsyncPlayerRankingDB db(options);
+      for (int i = 0; i < 10; ++i) {
+         db.RegisterPlayerResult("player #" + std::to_string(i), i);
+      }
+      checkpointed = db.Checkpoint().get();
+      rolledBack = db.RegisterPlayerResult("player #10", 10).get();
+      last = db.RegisterPlayerResult("player #11", 11).get();
+      EXPECT_EQ(rolledBack, db.Rollback(1).get());
+   }
+   {
+      // version written since checkpoint is replayed, so rollback moves to it by id
+      AsyncPlayerRankingDB db(options);
+      EXPECT_EQ(rolledBack, db.GetVersion());
+      EXPECT_EQ(11, db.GetPlayersInfo().size());
+      // restart checkpointed replayed writes, so rolling back past them saves new checkpoint
+      EXPECT_EQ(checkpointed, db.Rollback(1).get());
+   }
+   AsyncPlayerRankingDB db(options);
+   EXPECT_EQ(checkpointed, db.GetVersion());
+   EXPECT_EQ(10, db.GetPlayersInfo().size());
+   // ids given before restarts aren't reused, rolled back ones included
+   EXPECT_LT(last, db.RegisterPlayerResult("player #12", 12).get());
+}
+
+
+TEST(AsyncPlayerRankingDBTest, DurableSyncFailure)
+{
+   AsyncPlayerRankingDB::Options options;
+   options.durableDirectory = MakeEmptyDirectory("AsyncPlayerRankingDBTest.DurableSyncFailure");
+
+   std::vector<PlayerRankingDB::PlayerInfoRow> expected;
+   {
+      AsyncPlayerRankingDB db(options);
+      auto version = db.RegisterPlayerResult("A", 10).get();
+      expected = db.GetPlayersInfo();
+
+      // failed write is reverted, later ones are rejected until checkpoint starts new log
+      OperationLog::FailNextSync();
+      EXPECT_THROW(db.RegisterPlayerResult("B", 20).get(), std::runtime_error);
+      EXPECT_EQ(version, db.GetVersion());
+      EXPECT_THROW(db.RegisterPlayerResult("C", 30).get(), std::runtime_error);
+      EXPECT_THROW(db.Rollback(1).get(), std::runtime_error);
+      ExpectSamePlayers(expected, db);
+   }
+   {
+      // records of failed sync were written, but cut off the log, so they aren't replayed
+      AsyncPlayerRankingDB db(options);
+      ExpectSamePlayers(expected, db);
+
+      OperationLog::FailNextSync();
+      EXPECT_THROW(db.UnregisterPlayer("A").get(), std::runtime_error);
+      db.Checkpoint().get();
+      db.RegisterPlayerResult("D", 40).get();
+      expected = db.GetPlayersInfo();
+      EXPECT_EQ(2, expected.size());
+   }
+   AsyncPlayerRankingDB db(options);
+   ExpectSamePlayers(expected, db);
+}
+
+
+TEST(AsyncPlayerRankingDBTest, DurableTornLog)
+{
+   AsyncPlayerRankingDB::Options options;
+   options.durableDirectory = MakeEmptyDirectory("AsyncPlayerRankingDBTest.DurableTornLog");
+   const std::string logPath = options.durableDirectory + "/operations.log";
+
+   std::vector<PlayerRankingDB::PlayerInfoRow> expected;
+   {
+      AsyncPlayerRankingDB db(options);
+      db.RegisterPlayerResult("A", 10);
+      db.RegisterPlayerResult("B", 20).get();
+      expected = db.GetPlayersInfo();
+      db.RegisterPlayerResult("C", 30).get();
+   }
+
+   // last record is cut in the middle, as if crash happened during its write
+   auto size = std::filesystem::file_size(logPath);
+   std::filesystem::resize_file(logPath, size - 3);
+   {
+      AsyncPlayerRankingDB db(options);
+      ExpectSamePlayers(expected, db);
+      db.RegisterPlayerResult("D", 40).get();
+   }
+   AsyncPlayerRankingDB db(options);
+   EXPECT_EQ(3, db.GetPlayersInfo().size());
+   EXPECT_EQ(1, db.GetPlayerRank("D"));
+
+   {
+      std::ofstream out(logPath, std::ios::binary | std::ios::trunc);
+      out << "garbage";
+   }
+   EXPECT_THROW(AsyncPlayerRankingDB corrupted(options), std::runtime_error);
+}
+
@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <random>
+
+#include "LeaderboardReader.h"
+#include "PlayerRankingDB.h"
+
+
+static void ExpectSameAsSnapshot(const LeaderboardReader& reader, const PlayerRankingDB::Snapshot& snapshot)
+{
+   ASSERT_EQ(snapshot.GetVersion(), reader.GetVersion());
+   ASSERT_EQ(snapshot.GetPlayersCount(), reader.GetPlayersCount());
+   for (const auto& row : snapshot.GetPlayersInfo()) {
+      auto found = reader.FindPlayer(row.name);
+      ASSERT_TRUE(found) << row.name;
+      ASSERT_EQ(row.name, found->name);
+      ASSERT_EQ(row.rating, found->rating);
+      ASSERT_EQ(row.ranking, found->ranking);
+      ASSERT_EQ(row.ranking, reader.GetPlayerRank(row.name));
+   }
+
+   for (size_t offset : { 0, 1, 10, 500 }) {
+      auto page = reader.GetPlayersPage(offset, 25);
+      auto expected = snapshot.GetPlayersPage(offset, 25);
+      ASSERT_EQ(expected.size(), page.size());
+      for (size_t i = 0; i < page.size(); ++i) {
+         ASSERT_EQ(expected[i].name, page[i].name);
+         ASSERT_EQ(expected[i].rating, page[i].rating);
+         ASSERT_EQ(expected[i].ranking, page[i].ranking);
+      }
+   }
+}
+
+
+TEST(LeaderboardReaderTest, SameAsSnapshot)
+{
+   const std::string path = ::testing::TempDir() + "LeaderboardReaderTest.SameAsSnapshot";
+   PlayerRankingDB db;
+   std::mt19937 gen{ 7 };
+   std::uniform_int_distribution<int> rating{ -50, 200 };
+   for (int i = 0; i < 1000; ++i) {
+      db.RegisterPlayerResult("player #" + std::to_string(i), rating(gen));
+   }
+   db.RegisterPlayerResult("", 0);
+
+   auto snapshot = db.GetSnapshot();
+   ASSERT_TRUE(snapshot.SaveLeaderboard(path));
+   LeaderboardReader reader;
+   ASSERT_TRUE(reader.Open(path));
+   ExpectSameAsSnapshot(reader, snapshot);
+   EXPECT_EQ(0, reader.GetPlayerRank("nobody"));
+   EXPECT_FALSE(reader.FindPlayer("player #1000"));
+   EXPECT_EQ(reader.GetRowAt(0).name, reader.GetTopPlayers(1)[0].name);
+   EXPECT_TRUE(reader.GetPlayersPage(1001, 10).empty());
+
+   // mapped file is replaced under open reader, which keeps serving the version it mapped
+   db.UnregisterPlayer("player #0");
+   ASSERT_TRUE(db.GetSnapshot().SaveLeaderboard(path));
+   ExpectSameAsSnapshot(reader, snapshot);
+
+   LeaderboardReader moved(std::move(reader));
+   EXPECT_FALSE(reader.IsOpen());
+   ASSERT_TRUE(moved.Open(path));
+   ExpectSameAsSnapshot(moved, db.GetSnapshot());
+   EXPECT_EQ(0, moved.GetPlayerRank("player #0"));
+
+   PlayerRankingDB empty;
+   ASSERT_TRUE(empty.GetSnapshot().SaveLeaderboard(path));
+   ASSERT_TRUE(moved.Open(path));
+   EXPECT_EQ(0, moved.GetPlayersCount());
+   EXPECT_EQ(0, moved.GetPlayerRank(""));
+   EXPECT_TRUE(moved.GetTopPlayers(10).empty());
+   std::remove(path.c_str());
+}
+
+
+TEST(LeaderboardReaderTest, MalformedFiles)
+{
+   const std::string path = ::testing::TempDir() + "LeaderboardReaderTest.MalformedFiles";
+   LeaderboardReader reader;
+   EXPECT_FALSE(reader.Open(path));
+   EXPECT_EQ(0, reader.GetPlayerRank("A"));
+
+   PlayerRankingDB db;
+   for (int i = 0; i < 100; ++i) {
+      db.RegisterPlayerResult("player #" + std::to_string(i), i / 2);
+   }
+   ASSERT_TRUE(db.GetSnapshot().SaveLeaderboard(path));
+   std::string content;
+   {
+      std::ifstream in(path, std::ios::binary);
+      content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+   }
+   auto write = [&path] (const std::string& data) {
+      std::ofstream out(path, std::ios::binary | std::ios::trunc);
+      out.write(data.data(), data.size());
+   };
+
+   for (size_t size : { (size_t)0, (size_t)20, content.size() - 1 }) {
+      write(content.substr(0, size));
+      EXPECT_FALSE(reader.Open(path)) << size;
+   }
+   write(content + "x");
+   EXPECT_FALSE(reader.Open(path));
+
+   // damaged records and index are tolerated - lookups just miss
+   auto damaged = content;
+   for (size_t i = 48; i < damaged.size(); i += 5) {
+      damaged[i] = (char)0xFF;
+   }
+   write(damaged);
+   ASSERT_TRUE(reader.Open(path));
+   for (int i = 0; i < 100; ++i) {
+      reader.GetPlayerRank("player #" + std::to_string(i));
+   }
+   EXPECT_EQ(100, reader.GetPlayersPage(0, 1000).size());
+   std::remove(path.c_str());
+}
@@ -2,7 +2,9 @@
 #include <random>
 #include <stack>
 
+#include "BumpAllocator.h"
 #include "PersistentRedBlackTree.h"
+#include "RedBlackTreeCompactNode.h"
 
 
 using TestTree = PersistentRedBlackTree<int, int>;
@@ -167,4 +169,100 @@ TEST_P(PersistentRedBlackTree_Persistence_Param, BatchTest)
 
 INSTANTIATE_TEST_CASE_P(InsertProbability,
    PersistentRedBlackTree_Persistence_Param,
-   testing::Values(25, 50, 75, 100));
\ No newline at end of file
+   testing::Values(25, 50, 75, 100));
+
+
+TEST(PersistentRedBlackTree_Compact, Persistence)
+{
+   using CompactTree = PersistentRedBlackTree<int, int, std::less<int>, RedBlackTreeNodeMakerCompact>;
+   static_assert(sizeof(CompactTree::Node) <= 16, "compact node must fit 16 bytes");
+
+   BumpAllocator<CompactTree::Node>  nodeAlloc(64 * VirtualMemory::MB, 1 * VirtualMemory::MB);
+   BumpAllocator<CompactTree::Entry> entryAlloc(64 * VirtualMemory::MB, 1 * VirtualMemory::MB);
+
+   auto nodeMakerFn = [&] (CompactTree::NodeColor color, const CompactTree::EntryPtr& entry, const CompactTree::NodePtr& left, const CompactTree::NodePtr& right) -> CompactTree::NodePtr {
+      auto* node = nodeAlloc.Allocate();
+      node->link(color, entry, left, right);
+      return node;
+   };
+   auto entryMakerFn = [&] (CompactTree::Entry&& entry) -> CompactTree::EntryPtr {
+      auto* newEntry = entryAlloc.Allocate();
+      *newEntry = std::move(entry);
+      return newEntry;
+   };
+
+   std::mt19937 gen{ 42 };
+   std::uniform_int_distribution<int> dis{ 0, 5000 };
+   std::uniform_int_distribution<int> coin{ 0, 100 };
+
+   CompactTree tree{ nodeMakerFn, entryMakerFn };
+   TruthTree truth;
+   std::vector<std::pair<CompactTree, TruthTree>> history;
+   for (int i = 0; i < 100; ++i) {
+      for (int j = 0; j < 100; ++j) {
+         int key = dis(gen);
+         if (coin(gen) < 70) {
+            tree = tree.insert(key, j);
+            truth[key] = j;
+         } else {
+            tree = tree.remove(key);
+            truth.erase(key);
+         }
+      }
+      history.emplace_back(tree, truth);
+   }
+
+   for (const auto& [snapshot, snapshotTruth] : history) {
+      ASSERT_TRUE(snapshot.isValid());
+      ASSERT_EQ(snapshotTruth, snapshot.toMap());
+   }
+}
+
+
+TEST(PersistentRedBlackTree_Diff, VersionsDiff)
+{
+   std::mt19937 gen{ 7 };
+   std::uniform_int_distribution<int> dis{ 0, 2000 };
+   std::uniform_int_distribution<int> coin{ 0, 100 };
+
+   TestTree tree;
+   std::vector<TestTree> history;
+   for (int i = 0; i < 50; ++i) {
+      int changes = i % 10 == 0 ? 500 : i % 5;
+      for (int j = 0; j < changes; ++j) {
+         int key = dis(gen);
+         tree = coin(gen) < 70 ? tree.insert(key, dis(gen)) : tree.remove(key);
+      }
+      history.push_back(tree);
+   }
+   // unrelated tree with same content
+   TestTree rebuilt;
+   for (const auto& [key, value] : tree.toMap()) {
+      rebuilt = rebuilt.insert(key, value);
+   }
+   history.push_back(rebuilt);
+
+   for (const auto& from : history) {
+      for (const auto& to : history) {
+         TruthTree fromMap = from.toMap();
+         TruthTree toMap = to.toMap();
+
+         TruthTree applied = fromMap;
+         from.diff(to,
+            [&] (const TestTree::Entry& added) {
+               ASSERT_EQ(0, fromMap.count(added.first));
+               applied[added.first] = added.second;
+            },
+            [&] (const TestTree::Entry& removed) {
+               ASSERT_EQ(0, toMap.count(removed.first));
+               applied.erase(removed.first);
+            },
+            [&] (const TestTree::Entry& before, const TestTree::Entry& after) {
+               ASSERT_EQ(before.first, after.first);
+               ASSERT_NE(before.second, after.second);
+               applied[after.first] = after.second;
+            });
+         ASSERT_EQ(toMap, applied);
+      }
+   }
+}
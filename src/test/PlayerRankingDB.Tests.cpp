@@ -1,4 +1,13 @@
 #include <gtest/gtest.h>
+#include <atomic>
+#include <climits>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <thread>
 
 #include "PlayerRankingDB.h"
 
@@ -237,3 +246,1173 @@ TEST_F(PlayerRatingsTest_RepeatedRatings, UnregisterNonUnique)
    EXPECT_EQ(0, db->GetPlayerRank("C"));
    EXPECT_EQ(3, db->GetPlayerRank("D"));
 }
+
+
+TEST_F(PlayerRatingsTest_RepeatedRatings, RollbackThenRegister)
+{
+   db->Rollback(2);
+   db->RegisterPlayerResult("E", 50);
+   db->RegisterPlayerResult("F", 100);
+
+   EXPECT_EQ(1, db->GetPlayerRank("A"));
+   EXPECT_EQ(3, db->GetPlayerRank("B"));
+   EXPECT_EQ(0, db->GetPlayerRank("C"));
+   EXPECT_EQ(4, db->GetPlayerRank("E"));
+   EXPECT_EQ(1, db->GetPlayerRank("F"));
+
+   auto rows = db->GetPlayersInfo();
+   ASSERT_EQ(4, rows.size());
+   auto playerInfo = std::find(rows.begin(), rows.end(), "E");
+   ASSERT_NE(rows.end(), playerInfo);
+   EXPECT_EQ(50, playerInfo->rating);
+}
+
+
+TEST_F(PlayerRatingsTest_RepeatedRatings, RollbackRedo)
+{
+   db->Rollback(3);
+   EXPECT_EQ(1, db->GetPlayersInfo().size());
+
+   db->Redo(1);
+   EXPECT_EQ(2, db->GetPlayersInfo().size());
+   EXPECT_EQ(2, db->GetPlayerRank("B"));
+
+   db->Redo(100);
+   EXPECT_EQ(1, db->GetPlayerRank("A"));
+   EXPECT_EQ(3, db->GetPlayerRank("B"));
+   EXPECT_EQ(1, db->GetPlayerRank("C"));
+   EXPECT_EQ(4, db->GetPlayerRank("D"));
+
+   // no-op write keeps rolled back versions
+   db->Rollback(3);
+   db->UnregisterPlayer("E");
+   db->Redo(3);
+   EXPECT_EQ(4, db->GetPlayersInfo().size());
+
+   // actual write discards them
+   db->Rollback(3);
+   db->RegisterPlayerResult("E", 50);
+   db->Redo(1);
+   EXPECT_EQ(2, db->GetPlayersInfo().size());
+   EXPECT_EQ(2, db->GetPlayerRank("E"));
+   EXPECT_EQ(0, db->GetPlayerRank("D"));
+}
+
+
+TEST(PlayerRatingsTest, VersionsAndTags)
+{
+   PlayerRankingDB db;
+   PlayerRankingDB::Version empty = db.GetVersion();
+
+   auto v1 = db.RegisterPlayerResult("A", 10);
+   auto v2 = db.RegisterPlayerResult("B", 20);
+   EXPECT_LT(empty, v1);
+   EXPECT_LT(v1, v2);
+   EXPECT_EQ(v2, db.UnregisterPlayer("C")); // no-op doesn't create version
+   db.Tag("season start");
+
+   auto v3 = db.UnregisterPlayer("A");
+   EXPECT_LT(v2, v3);
+   EXPECT_EQ(v1, db.GetRollbackVersion(2));
+   EXPECT_EQ(empty, db.GetRollbackVersion(10));
+   EXPECT_EQ(v3, db.GetRollbackVersion(0));
+
+   ASSERT_TRUE(db.RollbackTo(v1));
+   EXPECT_EQ(v3, db.GetLastVersion());
+   EXPECT_EQ(v1, db.GetVersion());
+   EXPECT_EQ(1, db.GetPlayerRank("A"));
+   EXPECT_EQ(0, db.GetPlayerRank("B"));
+
+   // rolled back versions are reachable until next write
+   ASSERT_TRUE(db.RollbackToTag("season start"));
+   EXPECT_EQ(v2, db.GetVersion());
+   EXPECT_EQ(2, db.GetPlayerRank("A"));
+
+   ASSERT_TRUE(db.RollbackTo(empty));
+   auto v4 = db.RegisterPlayerResult("D", 0);
+   EXPECT_LT(v3, v4); // ids of discarded versions are not reused
+   EXPECT_FALSE(db.RollbackTo(v3));
+   EXPECT_FALSE(db.RollbackToTag("season start"));
+   EXPECT_FALSE(db.RollbackToTag("unknown"));
+   EXPECT_EQ(v4, db.GetVersion());
+
+   db.Rollback(1);
+   EXPECT_EQ(empty, db.GetVersion());
+
+   // ids given by previous DB instance aren't reused
+   db.ReserveVersions(v4 + 10);
+   db.ReserveVersions(v4);
+   EXPECT_EQ(v4 + 10, db.GetLastVersion());
+   EXPECT_EQ(v4 + 11, db.RegisterPlayerResult("E", 5));
+}
+
+
+TEST(PlayerRatingsTest, TimeTravelQueries)
+{
+   PlayerRankingDB db;
+
+   auto beforeMatch = db.RegisterPlayerResult("A", 100);
+   db.RegisterPlayerResult("B", 50);
+   auto afterMatch = db.RegisterPlayerResult("B", 150);
+   db.UnregisterPlayer("A");
+
+   EXPECT_EQ(1, db.GetPlayerRankAt(beforeMatch, "A"));
+   EXPECT_EQ(0, db.GetPlayerRankAt(beforeMatch, "B"));
+   EXPECT_EQ(2, db.GetPlayerRankAt(afterMatch, "A"));
+   EXPECT_EQ(1, db.GetPlayerRankAt(afterMatch, "B"));
+   EXPECT_EQ(0, db.GetPlayerRank("A"));
+
+   auto rows = db.GetPlayersInfoAt(afterMatch);
+   ASSERT_EQ(2, rows.size());
+   auto playerInfo = std::find(rows.begin(), rows.end(), "B");
+   ASSERT_NE(rows.end(), playerInfo);
+   EXPECT_EQ(150, playerInfo->rating);
+   EXPECT_EQ(1, playerInfo->ranking);
+
+   // queries don't move current version
+   EXPECT_EQ(1, db.GetPlayersInfo().size());
+
+   PlayerRankingDB::Version unknown = db.GetVersion() + 1;
+   EXPECT_FALSE(db.HasVersion(unknown));
+   EXPECT_EQ(0, db.GetPlayerRankAt(unknown, "B"));
+   EXPECT_TRUE(db.GetPlayersInfoAt(unknown).empty());
+}
+
+
+TEST(PlayerRatingsTest, HugePagesArenas)
+{
+   PlayerRankingDB::Options options;
+   options.arenaReserveSize = 64 << 20;
+   options.arenaPages = PlayerRankingDB::ArenaPages::HUGE_EXPLICIT;
+
+   // explicit huge pages may be unavailable - allocator must fallback silently
+   PlayerRankingDB db(options);
+   for (int i = 0; i < 1000; ++i) {
+      db.RegisterPlayerResult(std::to_string(i), i);
+   }
+   db.Rollback(500);
+
+   EXPECT_EQ(500, db.GetPlayersInfo().size());
+   EXPECT_EQ(1, db.GetPlayerRank("499"));
+   EXPECT_EQ(500, db.GetPlayerRank("0"));
+}
+
+
+TEST(PlayerRatingsTest, NodeArenasWithinLinkReach)
+{
+   if (sizeof(size_t) < 8) {
+      return;
+   }
+   // node arenas beyond 32-bit links reach are capped, entry arenas aren't linked by offsets
+   PlayerRankingDB::Options options;
+   options.arenaReserveSize = (size_t)(uint64_t(32) << 30);
+   PlayerRankingDB db(options);
+   db.RegisterPlayerResult("A", 10);
+   db.RegisterPlayerResult("B", 20);
+
+   auto stats = db.GetMemoryStats();
+   EXPECT_EQ((size_t)(uint64_t(16) << 30), stats.ratingsNodes.reservedBytes);
+   EXPECT_EQ((size_t)(uint64_t(16) << 30), stats.rankingsNodes.reservedBytes);
+   EXPECT_EQ(options.arenaReserveSize, stats.ratingsEntries.reservedBytes);
+   EXPECT_EQ(2, db.GetPlayerRank("A"));
+}
+
+
+TEST(PlayerRatingsTest, FileBackedArenas)
+{
+   auto directory = std::filesystem::path(::testing::TempDir()) / "PlayerRatingsTest.FileBackedArenas";
+   std::filesystem::remove_all(directory);
+   std::filesystem::create_directories(directory);
+
+   PlayerRankingDB::Options options;
+   options.arenaReserveSize = 64 << 20;
+   options.arenaPages = PlayerRankingDB::ArenaPages::FILE_BACKED;
+   options.arenaDirectory = directory.string();
+   {
+      PlayerRankingDB db(options);
+      for (int i = 0; i < 1000; ++i) {
+         db.RegisterPlayerResult(std::to_string(i), i);
+      }
+      db.Rollback(500);
+      auto fork = db.Fork();
+      fork.RegisterPlayerResult("fork", 1000);
+
+      EXPECT_EQ(500, db.GetPlayersInfo().size());
+      EXPECT_EQ(1, db.GetPlayerRank("499"));
+      EXPECT_EQ(500, db.GetPlayerRank("0"));
+      EXPECT_EQ(1, fork.GetPlayerRank("fork"));
+      EXPECT_LE(1000 * 16, db.GetMemoryStats().ratingsNodes.committedBytes);
+   }
+   // scratch files are gone with arenas
+   EXPECT_TRUE(std::filesystem::is_empty(directory));
+
+   // directory which can't take files - regular pages are used instead
+   options.arenaDirectory = (directory / "missing").string();
+   PlayerRankingDB db(options);
+   db.RegisterPlayerResult("A", 1);
+   EXPECT_EQ(1, db.GetPlayerRank("A"));
+}
+
+
+TEST(PlayerRatingsTest, UnregisterHighestRating)
+{
+   // rankings tree is ordered by descending ratings, removal has to follow the same order
+   PlayerRankingDB db;
+   db.RegisterPlayerResult("A", 1);
+   db.RegisterPlayerResult("B", 2);
+   db.UnregisterPlayer("B");
+
+   EXPECT_EQ(1, db.GetPlayerRank("A"));
+   ASSERT_EQ(1, db.GetPlayersInfo().size());
+   EXPECT_EQ(1, db.GetPlayersInfo()[0].ranking);
+}
+
+
+TEST(PlayerRatingsTest, RandomizedRankings)
+{
+   PlayerRankingDB db;
+   std::map<std::string, int> truth;
+
+   std::mt19937 gen{ 12345 };
+   std::uniform_int_distribution<int> player{ 0, 300 };
+   std::uniform_int_distribution<int> rating{ 0, 100 };
+   std::uniform_int_distribution<int> coin{ 0, 3 };
+
+   for (int i = 0; i < 2000; ++i) {
+      std::string name = std::to_string(player(gen));
+      if (coin(gen) == 0) {
+         db.UnregisterPlayer(name);
+         truth.erase(name);
+      } else {
+         int r = rating(gen);
+         db.UnregisterPlayer(name);
+         db.RegisterPlayerResult(name, r);
+         truth[name] = r;
+      }
+   }
+
+   auto rows = db.GetPlayersInfo();
+   ASSERT_EQ(truth.size(), rows.size());
+   for (const auto& row : rows) {
+      int expectedRank = 1;
+      for (const auto& [name, r] : truth) {
+         expectedRank += r > truth[row.name] ? 1 : 0;
+      }
+      ASSERT_EQ(truth[row.name], row.rating);
+      ASSERT_EQ(expectedRank, row.ranking) << row.name;
+   }
+}
+
+
+TEST(PlayerRatingsTest, MemoryStats)
+{
+   PlayerRankingDB db;
+
+   auto emptyStats = db.GetMemoryStats();
+   EXPECT_EQ(0, emptyStats.historyDepth);
+   EXPECT_EQ(0, emptyStats.liveBytes);
+   EXPECT_EQ(0, emptyStats.ratingsNodes.usedBytes);
+   EXPECT_LE(emptyStats.ratingsNodes.committedBytes, emptyStats.ratingsNodes.reservedBytes);
+
+   const int N = 100;
+   for (int i = 0; i < N; ++i) {
+      db.RegisterPlayerResult("player with a name too long for inline buffer #" + std::to_string(i), i);
+   }
+
+   auto stats = db.GetMemoryStats();
+   EXPECT_EQ(N, stats.historyDepth);
+   ASSERT_EQ(N, stats.versionBytes.size());
+   EXPECT_EQ(N, stats.ratingsEntries.count);
+   EXPECT_LE(stats.ratingsNodes.usedBytes, stats.ratingsNodes.committedBytes);
+   EXPECT_GT(stats.namesHeapBytes, 0);
+
+   size_t usedBytes = stats.ratingsNodes.usedBytes + stats.ratingsEntries.usedBytes + stats.rankingsNodes.usedBytes + stats.rankingsEntries.usedBytes;
+   size_t versionsBytes = 0;
+   for (size_t bytes : stats.versionBytes) {
+      EXPECT_GT(bytes, 0);
+      versionsBytes += bytes;
+   }
+   EXPECT_EQ(usedBytes, versionsBytes);
+   EXPECT_EQ(usedBytes + stats.namesHeapBytes, stats.liveBytes + stats.historyBytes);
+
+   db.Rollback(N / 2);
+
+   auto rolledBackStats = db.GetMemoryStats();
+   EXPECT_EQ(N / 2, rolledBackStats.historyDepth);
+   EXPECT_EQ(N / 2, rolledBackStats.redoDepth);
+   EXPECT_EQ(N, rolledBackStats.ratingsEntries.count); // rolled back versions are kept for Redo
+   EXPECT_LT(rolledBackStats.liveBytes, stats.liveBytes);
+   // names of rolled back players are held by history now
+   EXPECT_EQ(usedBytes + stats.namesHeapBytes, rolledBackStats.liveBytes + rolledBackStats.historyBytes);
+
+   db.RegisterPlayerResult("X", -1);
+
+   auto rewrittenStats = db.GetMemoryStats();
+   EXPECT_EQ(N / 2 + 1, rewrittenStats.historyDepth);
+   EXPECT_EQ(0, rewrittenStats.redoDepth);
+   EXPECT_EQ(N / 2 + 1, rewrittenStats.ratingsEntries.count);
+}
+
+
+TEST(PlayerRatingsTest, MemoryStatsOfCompactedHistory)
+{
+   PlayerRankingDB::Options options;
+   options.maxHistoryDepth = 4;
+   PlayerRankingDB db(options);
+   for (int i = 0; i < 2000; ++i) {
+      db.RegisterPlayerResult("player with a name too long for inline buffer #" + std::to_string(i % 100), i);
+   }
+
+   // names are counted as entries are made, released and copied by compaction - live part is the same as of loaded DB
+   std::vector<std::pair<std::string, int>> players;
+   for (const auto& row : db.GetPlayersInfo()) {
+      players.emplace_back(row.name, row.rating);
+   }
+   PlayerRankingDB loaded;
+   ASSERT_TRUE(loaded.BulkLoad(players).has_value());
+   auto loadedStats = loaded.GetMemoryStats();
+   EXPECT_EQ(0, loadedStats.historyBytes);
+
+   auto stats = db.GetMemoryStats();
+   EXPECT_EQ(loadedStats.liveBytes, stats.liveBytes);
+   EXPECT_LT(stats.historyDepth, 2 * options.maxHistoryDepth);
+   size_t usedBytes = stats.ratingsNodes.usedBytes + stats.ratingsEntries.usedBytes + stats.rankingsNodes.usedBytes + stats.rankingsEntries.usedBytes;
+   EXPECT_EQ(usedBytes + stats.namesHeapBytes, stats.liveBytes + stats.historyBytes);
+
+   db.Rollback(2);
+   auto rolledBackStats = db.GetMemoryStats();
+   EXPECT_EQ(stats.namesHeapBytes, rolledBackStats.namesHeapBytes);
+   EXPECT_EQ(usedBytes + stats.namesHeapBytes, rolledBackStats.liveBytes + rolledBackStats.historyBytes);
+   db.Redo(2);
+   EXPECT_EQ(stats.liveBytes, db.GetMemoryStats().liveBytes);
+
+   auto fork = db.Fork();
+   EXPECT_EQ(stats.liveBytes, fork.GetMemoryStats().liveBytes);
+}
+
+
+TEST(PlayerRatingsTest, BoundedHistory)
+{
+   const size_t maxDepth = 10;
+   PlayerRankingDB::Options options;
+   options.maxHistoryDepth = maxDepth;
+   PlayerRankingDB db(options);
+
+   // state after every version, to compare with after rollback
+   std::vector<std::map<std::string, int>> versions(1);
+
+   std::mt19937 gen{ 777 };
+   std::uniform_int_distribution<int> player{ 0, 200 };
+   std::uniform_int_distribution<int> rating{ 0, 1000 };
+
+   size_t maxUsedBytes = 0;
+   for (int i = 0; i < 20000; ++i) {
+      auto state = versions.back();
+      std::string name = std::to_string(player(gen));
+      if (state.count(name)) {
+         db.UnregisterPlayer(name);
+         state.erase(name);
+      } else {
+         int r = rating(gen);
+         db.RegisterPlayerResult(name, r);
+         state[name] = r;
+      }
+      versions.push_back(std::move(state));
+
+      if (i % 100 != 0) {
+         continue;
+      }
+      auto stats = db.GetMemoryStats();
+      EXPECT_LE(stats.historyDepth, 2 * maxDepth);
+      maxUsedBytes = std::max(maxUsedBytes, stats.ratingsNodes.usedBytes + stats.rankingsNodes.usedBytes);
+   }
+   // without compaction 20000 versions take ~20000 * 2 * log(200) nodes
+   EXPECT_LT(maxUsedBytes, 2000 * 2 * 8 * 16);
+
+   // rollback can't go further than max depth
+   auto rolledBack = db.GetRollbackVersion(100);
+   db.Rollback(100);
+   EXPECT_EQ(rolledBack, db.GetVersion());
+   const auto& expected = versions[versions.size() - 1 - maxDepth];
+
+   auto rows = db.GetPlayersInfo();
+   ASSERT_EQ(expected.size(), rows.size());
+   for (const auto& row : rows) {
+      ASSERT_EQ(expected.at(row.name), row.rating);
+      int expectedRank = 1;
+      for (const auto& [name, r] : expected) {
+         expectedRank += r > row.rating ? 1 : 0;
+      }
+      ASSERT_EQ(expectedRank, row.ranking);
+   }
+
+   // all older versions are dropped
+   db.Rollback(1);
+   EXPECT_EQ(expected.size(), db.GetPlayersInfo().size());
+   EXPECT_EQ(0, db.GetMemoryStats().historyDepth);
+}
+
+
+static void ExpectPlayers(const PlayerRankingDB& db, const std::map<std::string, int>& expected)
+{
+   auto rows = db.GetPlayersInfo();
+   ASSERT_EQ(expected.size(), rows.size());
+   for (const auto& row : rows) {
+      ASSERT_EQ(expected.at(row.name), row.rating);
+      int expectedRank = 1;
+      for (const auto& [name, r] : expected) {
+         expectedRank += r > row.rating ? 1 : 0;
+      }
+      ASSERT_EQ(expectedRank, row.ranking) << row.name;
+   }
+}
+
+
+static void ApplyRandomWrites(PlayerRankingDB& db, std::map<std::string, int>& state, std::mt19937& gen, int count)
+{
+   std::uniform_int_distribution<int> player{ 0, 300 };
+   std::uniform_int_distribution<int> rating{ 0, 1000 };
+   for (int i = 0; i < count; ++i) {
+      std::string name = "player #" + std::to_string(player(gen));
+      if (state.count(name)) {
+         db.UnregisterPlayer(name);
+         state.erase(name);
+      } else {
+         int r = rating(gen);
+         db.RegisterPlayerResult(name, r);
+         state[name] = r;
+      }
+   }
+}
+
+
+TEST(PlayerRatingsTest, Fork)
+{
+   PlayerRankingDB::Options options;
+   options.maxHistoryDepth = 5;
+   auto parent = std::make_unique<PlayerRankingDB>(options);
+
+   std::mt19937 gen{ 42 };
+   std::map<std::string, int> parentState;
+   ApplyRandomWrites(*parent, parentState, gen, 1000);
+   auto beforeFork = parent->GetVersion();
+   auto beforeForkState = parentState;
+   ApplyRandomWrites(*parent, parentState, gen, 1);
+
+   PlayerRankingDB fork = parent->Fork();
+   std::map<std::string, int> forkState = parentState;
+   EXPECT_EQ(parent->GetVersion(), fork.GetVersion());
+   // all nodes are shared, nothing is copied
+   EXPECT_EQ(0, fork.GetMemoryStats().ratingsEntries.count);
+   ExpectPlayers(fork, forkState);
+
+   // parent rewrites memory of version fork is based on and compacts its history while fork keeps using it
+   ASSERT_TRUE(parent->RollbackTo(beforeFork));
+   parentState = beforeForkState;
+   for (int i = 0; i < 20; ++i) {
+      ApplyRandomWrites(*parent, parentState, gen, 100);
+      ApplyRandomWrites(fork, forkState, gen, 100);
+   }
+   ExpectPlayers(*parent, parentState);
+   ExpectPlayers(fork, forkState);
+
+   PlayerRankingDB forkOfFork = fork.Fork();
+   std::map<std::string, int> forkOfForkState = forkState;
+   parent.reset();
+   for (int i = 0; i < 20; ++i) {
+      ApplyRandomWrites(fork, forkState, gen, 100);
+      ApplyRandomWrites(forkOfFork, forkOfForkState, gen, 100);
+   }
+   ExpectPlayers(fork, forkState);
+   ExpectPlayers(forkOfFork, forkOfForkState);
+
+   // fork history starts at fork point
+   forkOfFork.Rollback(1000);
+   EXPECT_EQ(0, forkOfFork.GetMemoryStats().historyDepth);
+}
+
+
+TEST(PlayerRatingsTest, ChangedPlayers)
+{
+   PlayerRankingDB db;
+   for (int i = 0; i < 1000; ++i) {
+      db.RegisterPlayerResult("player #" + std::to_string(i), i);
+   }
+   auto from = db.GetVersion();
+   db.UnregisterPlayer("player #10");
+   db.RegisterPlayerResult("newcomer", 5);
+   db.UnregisterPlayer("player #20");
+   db.RegisterPlayerResult("player #20", 2000);
+   auto to = db.GetVersion();
+
+   auto changes = db.ChangedPlayers(from, to);
+   ASSERT_EQ(3, changes.size());
+   EXPECT_EQ("newcomer", changes[0].name);
+   EXPECT_FALSE(changes[0].fromRating);
+   EXPECT_EQ(5, changes[0].toRating);
+   EXPECT_EQ("player #10", changes[1].name);
+   EXPECT_EQ(10, changes[1].fromRating);
+   EXPECT_FALSE(changes[1].toRating);
+   EXPECT_EQ("player #20", changes[2].name);
+   EXPECT_EQ(20, changes[2].fromRating);
+   EXPECT_EQ(2000, changes[2].toRating);
+
+   auto reverse = db.ChangedPlayers(to, from);
+   ASSERT_EQ(3, reverse.size());
+   EXPECT_EQ(5, reverse[0].fromRating);
+   EXPECT_FALSE(reverse[0].toRating);
+
+   EXPECT_TRUE(db.ChangedPlayers(to, to).empty());
+   EXPECT_TRUE(db.ChangedPlayers(from, to + 1).empty());
+}
+
+
+TEST(PlayerRatingsTest, ConcurrentReads)
+{
+   PlayerRankingDB::Options options;
+   options.maxHistoryDepth = 16; // compact history while readers run
+   options.concurrentReads = true;
+   PlayerRankingDB db(options);
+
+   const int N = 3000;
+   std::atomic<bool> done{ false };
+   std::thread writer([&] {
+      // every version holds players 0..k-1 with rating equal to their number
+      for (int i = 0; i < N; ++i) {
+         db.RegisterPlayerResult("player #" + std::to_string(i), i);
+      }
+      done = true;
+   });
+
+   std::vector<std::thread> readers;
+   std::atomic<int> failures{ 0 };
+   for (int r = 0; r < 4; ++r) {
+      readers.emplace_back([&, r] {
+         int lastRank = 0;
+         while (!done) {
+            if (r % 2 == 0) {
+               int rank = db.GetPlayerRank("player #0");
+               failures += rank < lastRank ? 1 : 0;
+               lastRank = rank;
+               continue;
+            }
+            auto rows = db.GetPlayersInfo();
+            int players = (int)rows.size();
+            for (const auto& row : rows) {
+               failures += row.ranking != players - row.rating ? 1 : 0;
+            }
+         }
+      });
+   }
+
+   writer.join();
+   for (auto& reader : readers) {
+      reader.join();
+   }
+   EXPECT_EQ(0, failures);
+   EXPECT_EQ(N, db.GetPlayerRank("player #0"));
+}
+
+
+TEST(PlayerRatingsTest, ConcurrentReadsWithRollback)
+{
+   PlayerRankingDB::Options options;
+   options.maxHistoryDepth = 64;
+   options.concurrentReads = true;
+   PlayerRankingDB db(options);
+
+   std::atomic<bool> done{ false };
+   std::thread writer([&] {
+      std::mt19937 gen{ 1 };
+      std::uniform_int_distribution<int> rating{ 0, 1000 };
+      for (int i = 0; i < 3000; ++i) {
+         db.RegisterPlayerResult("player #" + std::to_string(i), rating(gen));
+         // rolled back nodes are overwritten by next writes unless readers may still see them
+         db.RegisterPlayerResult("ghost #" + std::to_string(i), rating(gen));
+         db.RegisterPlayerResult("ghost #" + std::to_string(i + 1), rating(gen));
+         db.Rollback(2);
+      }
+      done = true;
+   });
+
+   std::vector<std::thread> readers;
+   std::atomic<int> failures{ 0 };
+   for (int r = 0; r < 3; ++r) {
+      readers.emplace_back([&] {
+         while (!done) {
+            auto rows = db.GetPlayersInfo();
+            std::vector<int> ratings;
+            for (const auto& row : rows) {
+               ratings.push_back(row.rating);
+            }
+            std::sort(ratings.begin(), ratings.end(), std::greater<int>());
+            for (const auto& row : rows) {
+               int expectedRank = 1 + int(std::lower_bound(ratings.begin(), ratings.end(), row.rating, std::greater<int>()) - ratings.begin());
+               failures += row.ranking != expectedRank ? 1 : 0;
+            }
+         }
+      });
+   }
+
+   writer.join();
+   for (auto& reader : readers) {
+      reader.join();
+   }
+   EXPECT_EQ(0, failures);
+   EXPECT_EQ(3000, db.GetPlayersInfo().size());
+}
+
+
+static void ExpectPlayersPages(const PlayerRankingDB::Snapshot& snapshot, const std::map<std::string, int>& expected)
+{
+   // ranking order, equal ratings ordered by name
+   std::vector<std::pair<int, std::string>> ordered;
+   for (const auto& [name, r] : expected) {
+      ordered.emplace_back(-r, name);
+   }
+   std::sort(ordered.begin(), ordered.end());
+
+   const size_t pageSize = 7;
+   for (size_t offset = 0; offset < ordered.size() + pageSize; offset += pageSize) {
+      auto page = snapshot.GetPlayersPage(offset, pageSize);
+      ASSERT_EQ(std::min(pageSize, ordered.size() - std::min(offset, ordered.size())), page.size());
+      for (size_t i = 0; i < page.size(); ++i) {
+         ASSERT_EQ(ordered[offset + i].second, page[i].name);
+         ASSERT_EQ(-ordered[offset + i].first, page[i].rating);
+         ASSERT_EQ(snapshot.GetPlayerRank(page[i].name), page[i].ranking);
+      }
+   }
+}
+
+
+TEST(PlayerRatingsTest, Snapshot)
+{
+   PlayerRankingDB::Options options;
+   options.maxHistoryDepth = 5;
+   auto db = std::make_unique<PlayerRankingDB>(options);
+
+   std::mt19937 gen{ 7 };
+   std::map<std::string, int> state;
+   ApplyRandomWrites(*db, state, gen, 1000);
+   auto beforeSnapshotState = state;
+   ApplyRandomWrites(*db, state, gen, 3);
+
+   auto snapshot = db->GetSnapshot();
+   auto snapshotCopy = snapshot;
+   auto snapshotState = state;
+   EXPECT_EQ(db->GetVersion(), snapshot.GetVersion());
+   EXPECT_EQ(state.size(), snapshot.GetPlayersCount());
+
+   // snapshot version is rolled back and its memory would be reused by next writes
+   db->Rollback(3);
+   state = beforeSnapshotState;
+   for (int i = 0; i < 20; ++i) {
+      ApplyRandomWrites(*db, state, gen, 100);
+   }
+   ExpectPlayers(*db, state);
+   db.reset();
+
+   auto rows = snapshotCopy.GetPlayersInfo();
+   ASSERT_EQ(snapshotState.size(), rows.size());
+   for (const auto& row : rows) {
+      EXPECT_EQ(snapshotState.at(row.name), row.rating);
+      EXPECT_EQ(snapshot.GetPlayerRank(row.name), row.ranking);
+   }
+   ExpectPlayersPages(snapshot, snapshotState);
+
+   auto top = snapshot.GetTopPlayers(3);
+   ASSERT_EQ(3, top.size());
+   EXPECT_EQ(1, top[0].ranking);
+   EXPECT_GE(top[0].rating, top[1].rating);
+   EXPECT_GE(top[1].rating, top[2].rating);
+   EXPECT_TRUE(snapshot.GetPlayersPage(snapshotState.size(), 10).empty());
+}
+
+
+TEST(PlayerRatingsTest, SnapshotEqualRatings)
+{
+   PlayerRankingDB db;
+   std::map<std::string, int> state;
+   for (int i = 0; i < 100; ++i) {
+      std::string name = "player #" + std::to_string(i);
+      db.RegisterPlayerResult(name, i % 4);
+      state[name] = i % 4;
+   }
+   auto snapshot = db.GetSnapshot();
+   ExpectPlayersPages(snapshot, state);
+
+   // page starting in the middle of equal ratings keeps their shared ranking
+   auto page = snapshot.GetPlayersPage(45, 10);
+   ASSERT_EQ(10, page.size());
+   EXPECT_EQ(26, page[0].ranking);
+   EXPECT_EQ(51, page.back().ranking);
+}
+
+
+TEST(PlayerRatingsTest, SnapshotPagesAfterCompaction)
+{
+   // compacted rankings reference copies of ratings entries, names are moved into them
+   PlayerRankingDB::Options options;
+   options.maxHistoryDepth = 5;
+   PlayerRankingDB db(options);
+
+   std::mt19937 gen{ 17 };
+   std::map<std::string, int> state;
+   for (int i = 0; i < 30; ++i) {
+      ApplyRandomWrites(db, state, gen, 100);
+      ExpectPlayersPages(db.GetSnapshot(), state);
+   }
+   EXPECT_LT(db.GetMemoryStats().historyDepth, 10);
+}
+
+
+TEST(PlayerRatingsTest, ConcurrentSnapshots)
+{
+   PlayerRankingDB::Options options;
+   options.maxHistoryDepth = 16;
+   options.concurrentReads = true;
+   PlayerRankingDB db(options);
+
+   std::atomic<bool> done{ false };
+   std::thread writer([&] {
+      for (int i = 0; i < 3000; ++i) {
+         db.RegisterPlayerResult("player #" + std::to_string(i), i);
+         db.RegisterPlayerResult("ghost #" + std::to_string(i), -1);
+         db.Rollback(1);
+      }
+      done = true;
+   });
+
+   // worker threads hold snapshots while writer keeps rolling back, reusing memory and compacting
+   std::vector<std::thread> readers;
+   std::atomic<int> failures{ 0 };
+   for (int r = 0; r < 3; ++r) {
+      readers.emplace_back([&] {
+         while (!done) {
+            // players 0..k-1 have rating equal to their number, ghost with rating -1 may be present
+            auto snapshot = db.GetSnapshot();
+            std::this_thread::yield();
+            auto rows = snapshot.GetPlayersInfo();
+            int players = (int)std::count_if(rows.begin(), rows.end(), [] (const auto& row) { return row.rating >= 0; });
+            for (const auto& row : rows) {
+               failures += row.ranking != (row.rating >= 0 ? players - row.rating : players + 1) ? 1 : 0;
+            }
+            auto page = snapshot.GetTopPlayers(10);
+            for (size_t i = 0; i < page.size(); ++i) {
+               failures += page[i].ranking != int(i + 1) || page[i].rating != players - int(i + 1) ? 1 : 0;
+            }
+         }
+      });
+   }
+
+   writer.join();
+   for (auto& reader : readers) {
+      reader.join();
+   }
+   EXPECT_EQ(0, failures);
+   EXPECT_EQ(3000, db.GetSnapshot().GetPlayersCount());
+}
+
+
+TEST(PlayerRatingsTest, UpdateRating)
+{
+   PlayerRankingDB db;
+   db.RegisterPlayerResult("A", 10);
+   db.RegisterPlayerResult("B", 20);
+   auto version = db.RegisterPlayerResult("C", 30);
+
+   // same rating again is a no-op
+   EXPECT_EQ(version, db.RegisterPlayerResult("A", 10));
+   EXPECT_EQ(3, db.GetPlayerRank("A"));
+
+   // player leaves old rating
+   db.RegisterPlayerResult("A", 40);
+   EXPECT_EQ(1, db.GetPlayerRank("A"));
+   EXPECT_EQ(3, db.GetPlayerRank("B"));
+   EXPECT_EQ(2, db.GetPlayerRank("C"));
+   EXPECT_EQ(3, db.GetSnapshot().GetPlayersCount());
+   EXPECT_EQ(0, db.GetSnapshot().CountPlayersAbove(40));
+
+   // no-op isn't a step, so Rollback reverts the move
+   version = db.GetVersion();
+   EXPECT_EQ(version, db.RegisterPlayerResult("A", 40));
+   db.Rollback(1);
+   EXPECT_EQ(3, db.GetPlayerRank("A"));
+   EXPECT_EQ(2, db.GetPlayerRank("B"));
+}
+
+
+TEST(PlayerRatingsTest, ApplyBatch)
+{
+   PlayerRankingDB db;
+   db.RegisterPlayerResult("A", 10);
+   auto before = db.GetVersion();
+
+   auto version = db.ApplyBatch({
+      { "B", 20 },
+      { "C", 30 },
+      { "A", 50 },
+      { "C", std::nullopt },
+      { "D", 5 },
+      { "A", 40 },
+   });
+   EXPECT_EQ(before + 1, version);
+   ExpectPlayers(db, { { "A", 40 }, { "B", 20 }, { "D", 5 } });
+
+   // no-op batch doesn't create version
+   EXPECT_EQ(version, db.ApplyBatch({ { "A", 40 }, { "C", std::nullopt } }));
+   EXPECT_EQ(version, db.ApplyBatch({}));
+
+   // whole batch is one rollback step
+   db.Rollback(1);
+   EXPECT_EQ(before, db.GetVersion());
+   ExpectPlayers(db, { { "A", 10 } });
+}
+
+
+TEST(PlayerRatingsTest, BulkLoad)
+{
+   std::mt19937 gen{ 11 };
+   std::uniform_int_distribution<int> player{ 0, 5000 };
+   std::uniform_int_distribution<int> rating{ 0, 1000 };
+   std::vector<std::pair<std::string, int>> players;
+   std::map<std::string, int> state;
+   for (int i = 0; i < 6000; ++i) {
+      // duplicated names, the last one wins
+      std::string name = "player #" + std::to_string(player(gen));
+      int r = rating(gen);
+      players.emplace_back(name, r);
+      state[name] = r;
+   }
+
+   for (size_t threadsCount : { 1, 3, 8 }) {
+      PlayerRankingDB db;
+      db.RegisterPlayerResult("replaced", 1);
+      auto before = db.GetVersion();
+      EXPECT_EQ(std::optional(before + 1), db.BulkLoad(players, threadsCount));
+      ExpectPlayers(db, state);
+      ExpectPlayersPages(db.GetSnapshot(), state);
+
+      // loaded trees are regular red-black trees for following writes
+      auto writtenState = state;
+      ApplyRandomWrites(db, writtenState, gen, 2000);
+      ExpectPlayers(db, writtenState);
+      ExpectPlayersPages(db.GetSnapshot(), writtenState);
+
+      db.RollbackTo(before);
+      ExpectPlayers(db, { { "replaced", 1 } });
+   }
+
+   PlayerRankingDB empty;
+   empty.BulkLoad({});
+   EXPECT_TRUE(empty.GetPlayersInfo().empty());
+}
+
+
+TEST(PlayerRatingsTest, ParallelExport)
+{
+   PlayerRankingDB db;
+   EXPECT_TRUE(db.GetSnapshot().ExportPlayersInfo(4).empty());
+
+   std::mt19937 gen{ 5 };
+   std::map<std::string, int> state;
+   for (int players : { 1, 2, 10, 3000 }) {
+      ApplyRandomWrites(db, state, gen, players);
+      auto snapshot = db.GetSnapshot();
+      auto expected = snapshot.GetPlayersInfo();
+      for (size_t threadsCount : { 1, 2, 3, 8 }) {
+         auto rows = snapshot.ExportPlayersInfo(threadsCount);
+         ASSERT_EQ(expected.size(), rows.size());
+         for (size_t i = 0; i < rows.size(); ++i) {
+            ASSERT_EQ(expected[i].name, rows[i].name);
+            ASSERT_EQ(expected[i].rating, rows[i].rating);
+            ASSERT_EQ(expected[i].ranking, rows[i].ranking);
+         }
+      }
+   }
+}
+
+
+TEST(PlayerRatingsTest, SaveLoadSnapshot)
+{
+   const std::string path = ::testing::TempDir() + "PlayerRatingsTest.SaveLoadSnapshot";
+   std::mt19937 gen{ 17 };
+   PlayerRankingDB db;
+   std::map<std::string, int> state;
+   ApplyRandomWrites(db, state, gen, 1000);
+   // names sharing prefixes of any length, extreme ratings and non-ASCII bytes
+   for (auto [name, r] : std::map<std::string, int>{ { "", 0 }, { "player", INT_MIN }, { "player #1000", INT_MAX }, { "player #10000", -1 }, { "\xFF\xFE", 7 } }) {
+      db.RegisterPlayerResult(name, r);
+      state[name] = r;
+   }
+   auto savedVersion = db.GetVersion();
+   ASSERT_TRUE(db.SaveSnapshot(path));
+
+   for (size_t threadsCount : { 1, 4 }) {
+      PlayerRankingDB loaded;
+      ASSERT_TRUE(loaded.LoadSnapshot(path, threadsCount));
+      EXPECT_EQ(savedVersion, loaded.GetVersion());
+      ExpectPlayers(loaded, state);
+      auto writtenState = state;
+      ApplyRandomWrites(loaded, writtenState, gen, 500);
+      ExpectPlayers(loaded, writtenState);
+   }
+
+   // DB which already gave greater ids loads snapshot as its next version
+   PlayerRankingDB newer;
+   for (int i = 0; i < (int)savedVersion + 10; ++i) {
+      newer.RegisterPlayerResult("other", i);
+   }
+   auto before = newer.GetVersion();
+   ASSERT_TRUE(newer.LoadSnapshot(path));
+   EXPECT_EQ(before + 1, newer.GetVersion());
+   ExpectPlayers(newer, state);
+   newer.Rollback(1);
+   ExpectPlayers(newer, { { "other", (int)savedVersion + 9 } });
+
+   // snapshot of older version is saved while DB moves on
+   auto snapshot = db.GetSnapshot();
+   db.UnregisterPlayer("player");
+   ASSERT_TRUE(snapshot.Save(path));
+   PlayerRankingDB fromSnapshot;
+   ASSERT_TRUE(fromSnapshot.LoadSnapshot(path));
+   ExpectPlayers(fromSnapshot, state);
+
+   PlayerRankingDB empty;
+   ASSERT_TRUE(empty.SaveSnapshot(path));
+   ASSERT_TRUE(fromSnapshot.LoadSnapshot(path));
+   EXPECT_TRUE(fromSnapshot.GetPlayersInfo().empty());
+   std::remove(path.c_str());
+}
+
+
+TEST(PlayerRatingsTest, SaveApplyChanges)
+{
+   const std::string path = ::testing::TempDir() + "PlayerRatingsTest.SaveApplyChanges";
+   std::mt19937 gen{ 19 };
+   PlayerRankingDB db;
+   std::map<std::string, int> state;
+   ApplyRandomWrites(db, state, gen, 1000);
+   PlayerRankingDB copy = db.Fork();
+   auto fromVersion = db.GetVersion();
+
+   ApplyRandomWrites(db, state, gen, 100);
+   db.UnregisterPlayer(state.begin()->first);
+   state.erase(state.begin());
+   ASSERT_TRUE(db.SaveChanges(path, fromVersion));
+   auto version = copy.GetVersion();
+   ASSERT_TRUE(copy.ApplyChanges(path));
+   // applied version takes saved id, later writes get greater ones
+   EXPECT_EQ(db.GetVersion(), copy.GetVersion());
+   ExpectPlayers(copy, state);
+   PlayerRankingDB empty;
+   ASSERT_TRUE(db.SaveChanges(path, db.GetVersion()));
+   ASSERT_TRUE(empty.ApplyChanges(path));
+   EXPECT_EQ(db.GetVersion(), empty.GetVersion());
+   EXPECT_LT(db.GetVersion(), empty.RegisterPlayerResult("A", 1));
+   ASSERT_TRUE(db.SaveChanges(path, fromVersion));
+   // all changes are a single version
+   copy.Rollback(1);
+   EXPECT_EQ(version, copy.GetVersion());
+
+   // full snapshot isn't taken for changes and vice versa
+   EXPECT_FALSE(copy.LoadSnapshot(path));
+   ASSERT_TRUE(db.SaveSnapshot(path));
+   EXPECT_FALSE(copy.ApplyChanges(path));
+   EXPECT_EQ(version, copy.GetVersion());
+
+   EXPECT_FALSE(db.SaveChanges(path, db.GetVersion() + 1));
+   std::remove(path.c_str());
+}
+
+
+TEST(PlayerRatingsTest, ImportPlayers)
+{
+   const std::string path = ::testing::TempDir() + "PlayerRatingsTest.ImportPlayers";
+   auto write = [&path] (const std::string& data) {
+      std::ofstream out(path, std::ios::binary | std::ios::trunc);
+      out.write(data.data(), data.size());
+   };
+
+   // file spans many read chunks, names repeat so the last rating wins
+   std::mt19937 gen{ 23 };
+   std::uniform_int_distribution<int> dis{ -1000000, 1000000 };
+   std::map<std::string, int> state;
+   std::string content = "name,rating\r\n";
+   for (int i = 0; i < 150000; ++i) {
+      std::string name = "player #" + std::to_string(dis(gen) & 0x3FF);
+      int rating = dis(gen);
+      content += name + "," + std::to_string(rating) + (i % 2 ? "\n" : "\r\n");
+      state[name] = rating;
+   }
+   // quoted names with separators, quotes and line breaks, unquoted one with separators
+   content += "\"a,\"\"b\"\"\nc\", -5\n\n\"\",2147483647\nx,y,-2147483648";
+   state["a,\"b\"\nc"] = -5;
+   state[""] = INT_MAX;
+   state["x,y"] = INT_MIN;
+   write(content);
+
+   PlayerRankingDB db;
+   db.RegisterPlayerResult("replaced", 1);
+   auto version = db.GetVersion();
+   ASSERT_TRUE(db.ImportPlayers(path, ',', 2));
+   EXPECT_EQ(version + 1, db.GetVersion());
+   ExpectPlayers(db, state);
+
+   write("name\trating\nA\t10\nB,C\t 20 \nO\"Neil\t30\n");
+   ASSERT_TRUE(db.ImportPlayers(path, '\t'));
+   ExpectPlayers(db, { { "A", 10 }, { "B,C", 20 }, { "O\"Neil", 30 } });
+
+   version = db.GetVersion();
+   for (const char* malformed : { "A,1\nB,x\n", "A,1\nB\n", "A,2147483648", "\"A\"B,1", "\"A,1\nB,2", "A,1\nname,rating" }) {
+      write(malformed);
+      EXPECT_FALSE(db.ImportPlayers(path)) << malformed;
+   }
+   EXPECT_FALSE(db.ImportPlayers(path + ".missing"));
+   EXPECT_EQ(version, db.GetVersion());
+
+   write("");
+   ASSERT_TRUE(db.ImportPlayers(path));
+   EXPECT_TRUE(db.GetPlayersInfo().empty());
+   std::remove(path.c_str());
+}
+
+
+TEST(PlayerRatingsTest, ExportLeaderboard)
+{
+   std::mt19937 gen{ 29 };
+   PlayerRankingDB db;
+   std::map<std::string, int> state;
+   ApplyRandomWrites(db, state, gen, 1000);
+   db.RegisterPlayerResult("quoted \"name\", with comma", 500);
+   auto snapshot = db.GetSnapshot();
+   db.RegisterPlayerResult("after snapshot", 1);
+
+   // ranking order, equal ratings ordered by name
+   auto rows = snapshot.GetPlayersInfo();
+   std::stable_sort(rows.begin(), rows.end(), [] (const auto& left, const auto& right) { return left.ranking < right.ranking; });
+   std::string expectedCsv = "name,rating,ranking\n";
+   std::string expectedBinary;
+   auto appendFixed = [&expectedBinary] (uint64_t value, size_t size) {
+      for (size_t i = 0; i < size; ++i) {
+         expectedBinary.push_back((char)(value >> (8 * i)));
+      }
+   };
+   appendFixed(rows.size(), 8);
+   for (const auto& row : rows) {
+      std::string name = row.name == "quoted \"name\", with comma" ? "\"quoted \"\"name\"\", with comma\"" : row.name;
+      expectedCsv += name + "," + std::to_string(row.rating) + "," + std::to_string(row.ranking) + "\n";
+      appendFixed(row.name.size(), 4);
+      expectedBinary += row.name;
+      appendFixed((uint32_t)row.rating, 4);
+      appendFixed((uint32_t)row.ranking, 4);
+   }
+
+   std::ostringstream csv;
+   ASSERT_TRUE(snapshot.ExportLeaderboard(csv));
+   EXPECT_EQ(expectedCsv, csv.str());
+   std::ostringstream binary;
+   ASSERT_TRUE(snapshot.ExportLeaderboard(binary, PlayerRankingDB::ExportFormat::BINARY));
+   EXPECT_EQ(expectedBinary, binary.str());
+
+   std::ostringstream current;
+   ASSERT_TRUE(db.ExportLeaderboard(current));
+   EXPECT_NE(std::string::npos, current.str().find("\nafter snapshot,1,"));
+
+   std::ostringstream failed;
+   failed.setstate(std::ios::badbit);
+   EXPECT_FALSE(snapshot.ExportLeaderboard(failed));
+   std::ostringstream empty;
+   ASSERT_TRUE(PlayerRankingDB().ExportLeaderboard(empty));
+   EXPECT_EQ("name,rating,ranking\n", empty.str());
+}
+
+
+TEST(PlayerRatingsTest, LoadCorruptedSnapshot)
+{
+   const std::string path = ::testing::TempDir() + "PlayerRatingsTest.LoadCorruptedSnapshot";
+   PlayerRankingDB db;
+   EXPECT_FALSE(db.LoadSnapshot(path));
+
+   for (int i = 0; i < 100; ++i) {
+      db.RegisterPlayerResult("player #" + std::to_string(i), i);
+   }
+   ASSERT_TRUE(db.SaveSnapshot(path));
+   std::string content;
+   {
+      std::ifstream in(path, std::ios::binary);
+      content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+   }
+   auto write = [&path] (const std::string& data) {
+      std::ofstream out(path, std::ios::binary | std::ios::trunc);
+      out.write(data.data(), data.size());
+   };
+
+   PlayerRankingDB target;
+   target.RegisterPlayerResult("kept", 1);
+   auto version = target.GetVersion();
+   for (size_t i = 0; i < content.size(); i += 7) {
+      auto corrupted = content;
+      corrupted[i] ^= 0x20;
+      write(corrupted);
+      ASSERT_FALSE(target.LoadSnapshot(path)) << i;
+   }
+   for (size_t size : { (size_t)0, (size_t)10, content.size() / 2, content.size() - 1 }) {
+      write(content.substr(0, size));
+      ASSERT_FALSE(target.LoadSnapshot(path)) << size;
+   }
+   EXPECT_EQ(version, target.GetVersion());
+   ExpectPlayers(target, { { "kept", 1 } });
+
+   write(content);
+   EXPECT_TRUE(target.LoadSnapshot(path));
+   EXPECT_EQ(100, target.GetPlayersInfo().size());
+   std::remove(path.c_str());
+}
+
+
+TEST(PlayerRatingsTest, LoadExhaustedArenas)
+{
+   const std::string path = ::testing::TempDir() + "PlayerRatingsTest.LoadExhaustedArenas";
+   std::vector<std::pair<std::string, int>> players;
+   for (int i = 0; i < 100000; ++i) {
+      players.emplace_back("player #" + std::to_string(i), i % 1000);
+   }
+   {
+      PlayerRankingDB source;
+      source.BulkLoad(players);
+      ASSERT_TRUE(source.SaveSnapshot(path));
+   }
+
+   PlayerRankingDB::Options options;
+   options.arenaReserveSize = 1 << 20;
+   PlayerRankingDB db(options);
+   db.RegisterPlayerResult("kept", 1);
+   db.RegisterPlayerResult("redo", 2);
+   db.Rollback(1);
+   auto version = db.GetVersion();
+
+   // nothing is changed when trees don't fit, even rolled back versions are kept for Redo
+   EXPECT_FALSE(db.BulkLoad(players).has_value());
+   EXPECT_FALSE(db.LoadSnapshot(path));
+   {
+      std::ofstream out(path, std::ios::binary | std::ios::trunc);
+      for (const auto& [name, rating] : players) {
+         out << name << ',' << rating << '\n';
+      }
+   }
+   EXPECT_FALSE(db.ImportPlayers(path));
+   EXPECT_EQ(version, db.GetVersion());
+   ExpectPlayers(db, { { "kept", 1 } });
+   db.Redo(1);
+   ExpectPlayers(db, { { "kept", 1 }, { "redo", 2 } });
+
+   players.resize(1000);
+   auto loaded = db.BulkLoad(players);
+   ASSERT_TRUE(loaded.has_value());
+   EXPECT_LT(version, *loaded);
+   EXPECT_EQ(*loaded, db.GetVersion());
+   EXPECT_EQ(1000, db.GetPlayersInfo().size());
+   std::remove(path.c_str());
+}
+
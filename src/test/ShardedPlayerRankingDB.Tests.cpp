@@ -0,0 +1,163 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <map>
+#include <random>
+#include <thread>
+
+#include "ShardedPlayerRankingDB.h"
+
+
+static void ExpectSameAsSingleDB(const ShardedPlayerRankingDB& sharded, const PlayerRankingDB& single)
+{
+   auto snapshot = sharded.GetSnapshot();
+   auto rows = snapshot.GetPlayersInfo();
+   auto expectedRows = single.GetPlayersInfo();
+   ASSERT_EQ(expectedRows.size(), rows.size());
+   for (size_t i = 0; i < rows.size(); ++i) {
+      ASSERT_EQ(expectedRows[i].name, rows[i].name);
+      ASSERT_EQ(expectedRows[i].rating, rows[i].rating);
+      ASSERT_EQ(expectedRows[i].ranking, rows[i].ranking) << rows[i].name;
+      ASSERT_EQ(expectedRows[i].ranking, sharded.GetPlayerRank(rows[i].name));
+   }
+
+   auto singleSnapshot = single.GetSnapshot();
+   for (size_t offset : { 0, 5, 100, 995 }) {
+      auto page = snapshot.GetPlayersPage(offset, 10);
+      auto expectedPage = singleSnapshot.GetPlayersPage(offset, 10);
+      ASSERT_EQ(expectedPage.size(), page.size());
+      for (size_t i = 0; i < page.size(); ++i) {
+         ASSERT_EQ(expectedPage[i].name, page[i].name);
+         ASSERT_EQ(expectedPage[i].ranking, page[i].ranking);
+      }
+   }
+}
+
+
+TEST(ShardedPlayerRankingDBTest, SameAsSingleDB)
+{
+   ShardedPlayerRankingDB sharded(4);
+   PlayerRankingDB single;
+   EXPECT_EQ(4, sharded.GetShardCount());
+   EXPECT_EQ(0, sharded.GetPlayerRank("nobody"));
+
+   std::mt19937 gen{ 3 };
+   std::uniform_int_distribution<int> player{ 0, 1000 };
+   std::uniform_int_distribution<int> rating{ 0, 300 };
+   for (int i = 0; i < 3000; ++i) {
+      std::string name = "player #" + std::to_string(player(gen));
+      if (single.GetPlayerRank(name) != 0) {
+         sharded.UnregisterPlayer(name);
+         single.UnregisterPlayer(name);
+      } else {
+         int r = rating(gen);
+         sharded.RegisterPlayerResult(name, r);
+         single.RegisterPlayerResult(name, r);
+      }
+   }
+   ExpectSameAsSingleDB(sharded, single);
+}
+
+
+TEST(ShardedPlayerRankingDBTest, RollbackToVersionVector)
+{
+   ShardedPlayerRankingDB db(3);
+   for (int i = 0; i < 100; ++i) {
+      db.RegisterPlayerResult("player #" + std::to_string(i), i);
+   }
+   auto version = db.GetVersion();
+   ASSERT_EQ(3, version.size());
+   auto snapshot = db.GetSnapshot();
+   EXPECT_EQ(version, snapshot.GetVersion());
+
+   for (int i = 100; i < 200; ++i) {
+      db.RegisterPlayerResult("player #" + std::to_string(i), i);
+   }
+   db.UnregisterPlayer("player #99");
+   EXPECT_EQ(199, db.GetPlayerRank("player #0"));
+
+   ASSERT_TRUE(db.RollbackTo(version));
+   EXPECT_EQ(version, db.GetVersion());
+   EXPECT_EQ(100, db.GetPlayerRank("player #0"));
+   EXPECT_EQ(1, db.GetPlayerRank("player #99"));
+   EXPECT_EQ(0, db.GetPlayerRank("player #100"));
+
+   // snapshot isn't affected by later writes
+   EXPECT_EQ(100, snapshot.GetPlayersCount());
+   EXPECT_EQ(1, snapshot.GetPlayerRank("player #99"));
+
+   auto unknown = version;
+   unknown[1] += 1000;
+   EXPECT_FALSE(db.RollbackTo(unknown));
+   EXPECT_FALSE(db.RollbackTo({ 0 }));
+   EXPECT_EQ(version, db.GetVersion());
+}
+
+
+TEST(ShardedPlayerRankingDBTest, ConcurrentWriters)
+{
+   ShardedPlayerRankingDB db(4);
+   const int threadsCount = 4;
+   const int N = 2000;
+
+   std::vector<std::thread> writers;
+   for (int t = 0; t < threadsCount; ++t) {
+      writers.emplace_back([&db, t] {
+         for (int i = t; i < N; i += threadsCount) {
+            db.RegisterPlayerResult("player #" + std::to_string(i), i);
+         }
+      });
+   }
+
+   // snapshots are taken and read while writers run
+   std::atomic<bool> done{ false };
+   std::atomic<int> failures{ 0 };
+   std::thread reader([&] {
+      while (!done) {
+         auto snapshot = db.GetSnapshot();
+         auto top = snapshot.GetTopPlayers(5);
+         for (size_t i = 0; i < top.size(); ++i) {
+            failures += top[i].ranking != int(i + 1) ? 1 : 0;
+         }
+      }
+   });
+
+   for (auto& writer : writers) {
+      writer.join();
+   }
+   done = true;
+   reader.join();
+
+   EXPECT_EQ(0, failures);
+   auto snapshot = db.GetSnapshot();
+   EXPECT_EQ(N, snapshot.GetPlayersCount());
+   for (const auto& row : snapshot.GetPlayersInfo()) {
+      ASSERT_EQ(N - row.rating, row.ranking);
+   }
+}
+
+
+TEST(ShardedPlayerRankingDBTest, ConsistentRankDuringWrites)
+{
+   ShardedPlayerRankingDB db(4);
+   db.RegisterPlayerResult("probe", 0);
+   db.RegisterPlayerResult("token #0", 100);
+
+   // token passes between players of any shards, one of them always holds it
+   std::atomic<bool> done{ false };
+   std::thread writer([&] {
+      for (int i = 0; i < 20000; ++i) {
+         db.RegisterPlayerResult("token #" + std::to_string((i + 1) % 8), 100);
+         db.UnregisterPlayer("token #" + std::to_string(i % 8));
+      }
+      done = true;
+   });
+
+   int failures = 0;
+   while (!done) {
+      failures += db.GetPlayerRank("probe") < 2 ? 1 : 0;
+   }
+   writer.join();
+
+   EXPECT_EQ(0, failures);
+   EXPECT_EQ(2, db.GetPlayerRank("probe"));
+}